@@ -26,9 +26,13 @@ SOURCES += main.cpp\
     processingdialog.cpp \
     neuralnetsettingsdialog.cpp \
     nuclearphysicsperceptron.cpp \
+    compiledperceptron.cpp \
+    quantizedperceptron.cpp \
     teachingclass.cpp \
+    minibatchtrainer.cpp \
     perceptron.cpp \
     neuron_base.cpp \
+    activation.cpp \
     qcustomplot/qcustomplot.cpp \
     nuclteachingclass.cpp \
     streamsmanagerdialog.cpp \
@@ -38,7 +42,8 @@ SOURCES += main.cpp\
     debugmenu.cpp \
     autosavedialog.cpp \
     interpolator.cpp \
-    processingsettings.cpp
+    processingsettings.cpp \
+    noisemonitor.cpp
 
 HEADERS  += mainwindow.hpp \
    audiodetector.hpp \
@@ -50,11 +55,16 @@ HEADERS  += mainwindow.hpp \
     processingdialog.hpp \
     neuralnetsettingsdialog.hpp \
     nuclearphysicsperceptron.hpp \
+    compiledperceptron.hpp \
+    quantizedperceptron.hpp \
     teachingclass.hpp \
+    minibatchtrainer.hpp \
     perceptron.hpp \
     neuron_base.hpp \
+    activation.hpp \
     qcustomplot/qcustomplot.h \
     fft.hpp \
+    pulsekernels.hpp \
     nuclteachingclass.hpp \
     streamsmanagerdialog.hpp \
     serialport.hpp \
@@ -64,6 +74,7 @@ HEADERS  += mainwindow.hpp \
     autosavedialog.hpp \
     datum_types.hpp \
     interpolator.hpp \
-    processingsettings.hpp
+    processingsettings.hpp \
+    noisemonitor.hpp
 
 
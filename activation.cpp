@@ -0,0 +1,163 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "activation.hpp"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ACTIVATION_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace Neural_Network {
+
+typedef void (*ActivationFunc) (float*, quint32);
+
+struct Kernels {
+	ActivationFunc sigmoid;
+	ActivationFunc tanh;
+	ActivationFunc fastSigmoid;
+	ActivationFunc fastTanh;
+};
+
+static void sigmoid_direct (float* data, quint32 size) {
+	for (quint32 i = 0; i < size; ++i) data[i] = 1.f/(1.f + std::exp(data[i]));
+}
+
+static void tanh_direct (float* data, quint32 size) {
+	for (quint32 i = 0; i < size; ++i) data[i] = std::tanh(data[i]);
+}
+
+#ifdef ACTIVATION_X86_SIMD
+// exp(x) for |x| <= 87: x = n*ln2 + r with |r| <= ln2/2, exp(r) by the
+// Cephes polynomial (about 2 ulp), 2^n through the exponent bits
+__attribute__((target("avx2,fma")))
+static inline __m256 exp_avx2 (__m256 x) {
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.f)), _mm256_set1_ps(87.f));
+	__m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+	r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+	__m256 p = _mm256_set1_ps(1.9875691500e-4f);
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+	p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+	p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.f)));
+	__m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+// exp(x) = 2^(x*log2e) with a cubic for the fractional power, relative
+// error below 1.5e-4
+__attribute__((target("avx2,fma")))
+static inline __m256 fast_exp_avx2 (__m256 x) {
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.f)), _mm256_set1_ps(87.f));
+	__m256 t = _mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f));
+	__m256 n = _mm256_floor_ps(t);
+	__m256 f = _mm256_sub_ps(t, n);
+	__m256 p = _mm256_fmadd_ps(_mm256_set1_ps(0.0794402384f), f, _mm256_set1_ps(0.224494337f));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(0.696065642f));
+	p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.f));
+	__m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+	return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 sigmoid_avx2 (__m256 x) {
+	return _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_add_ps(_mm256_set1_ps(1.f), exp_avx2(x)));
+}
+
+// tanh(x) = x + x^3*P(x^2) (Cephes) for |x| < 0.625, 1 - 2/(exp(2|x|) + 1)
+// with the sign of x otherwise
+__attribute__((target("avx2,fma")))
+static inline __m256 tanh_avx2 (__m256 x) {
+	const __m256 sign = _mm256_set1_ps(-0.f);
+	__m256 a = _mm256_andnot_ps(sign, x);
+	__m256 z = _mm256_mul_ps(x, x);
+	__m256 p = _mm256_fmadd_ps(_mm256_set1_ps(-5.70498872745e-3f), z, _mm256_set1_ps(2.06390887954e-2f));
+	p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(-5.37397155531e-2f));
+	p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(1.33314422036e-1f));
+	p = _mm256_fmadd_ps(p, z, _mm256_set1_ps(-3.33332819422e-1f));
+	__m256 small = _mm256_fmadd_ps(_mm256_mul_ps(p, z), x, x);
+	__m256 e = exp_avx2(_mm256_add_ps(a, a));
+	__m256 large = _mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_div_ps(_mm256_set1_ps(2.f), _mm256_add_ps(e, _mm256_set1_ps(1.f))));
+	large = _mm256_or_ps(large, _mm256_and_ps(sign, x));
+	return _mm256_blendv_ps(large, small, _mm256_cmp_ps(a, _mm256_set1_ps(0.625f), _CMP_LT_OQ));
+}
+
+// Reciprocal estimate (relative error below 3.7e-4) instead of the division
+__attribute__((target("avx2,fma")))
+static inline __m256 fast_sigmoid_avx2 (__m256 x) {
+	return _mm256_rcp_ps(_mm256_add_ps(_mm256_set1_ps(1.f), fast_exp_avx2(x)));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 fast_tanh_avx2 (__m256 x) {
+	__m256 r = _mm256_rcp_ps(_mm256_add_ps(_mm256_set1_ps(1.f), fast_exp_avx2(_mm256_add_ps(x, x))));
+	return _mm256_fnmadd_ps(_mm256_set1_ps(2.f), r, _mm256_set1_ps(1.f));
+}
+
+// The tail is padded into a full vector so that every element of a layer
+// goes through the same approximation
+template <__m256 (*func) (__m256)>
+__attribute__((target("avx2,fma")))
+static void layer_avx2 (float* data, quint32 size) {
+	quint32 i = 0;
+	for (; i + 8 <= size; i += 8) _mm256_storeu_ps(data + i, func(_mm256_loadu_ps(data + i)));
+	if (i < size) {
+		float tail[8] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+		for (quint32 k = i; k < size; ++k) tail[k - i] = data[k];
+		_mm256_storeu_ps(tail, func(_mm256_loadu_ps(tail)));
+		for (quint32 k = i; k < size; ++k) data[k] = tail[k - i];
+	}
+}
+#endif
+
+// Without AVX2 the fast variants are the exact ones
+static Kernels select_kernels () {
+	Kernels k = {&sigmoid_direct, &tanh_direct, &sigmoid_direct, &tanh_direct};
+#ifdef ACTIVATION_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		k.sigmoid = &layer_avx2<sigmoid_avx2>;
+		k.tanh = &layer_avx2<tanh_avx2>;
+		k.fastSigmoid = &layer_avx2<fast_sigmoid_avx2>;
+		k.fastTanh = &layer_avx2<fast_tanh_avx2>;
+	}
+#endif
+	return k;
+}
+
+static const Kernels kernels = select_kernels();
+
+void activate (quint32 id, float* data, quint32 size, bool fast) {
+	switch (id) {
+		case SIGMOID_ID:
+			(fast ? kernels.fastSigmoid : kernels.sigmoid)(data, size);
+			break;
+		case HIPERBOLIC_TAN_ID:
+			(fast ? kernels.fastTanh : kernels.tanh)(data, size);
+			break;
+		default:
+			break;
+	}
+}
+
+}
@@ -0,0 +1,62 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef ACTIVATION_HPP
+#define ACTIVATION_HPP
+
+#include <QtGlobal>
+#include <cmath>
+
+namespace Neural_Network {
+
+enum Activation_Functions_IDs {
+	SIGMOID_ID = (quint32)0,
+	LINEAR_ID,
+	HIPERBOLIC_TAN_ID
+};
+
+// Largest absolute deviation of the fast activations from the exact ones
+constexpr float FastActivationError = 1e-3f;
+
+// Note the sign convention of the sigmoid: 1/(1 + exp(f))
+inline float activation_value (quint32 id, float f) {
+	switch (id) {
+		case SIGMOID_ID: return 1.f/(1.f + std::exp(f));
+		case HIPERBOLIC_TAN_ID: return std::tanh(f);
+		default: return f;
+	}
+}
+
+// Derivative expressed through the activation output
+inline float activation_diff (quint32 id, float out) {
+	switch (id) {
+		case SIGMOID_ID: return out*(out - 1.f);
+		case HIPERBOLIC_TAN_ID: return 1.f - out*out;
+		default: return 1.f;
+	}
+}
+
+// Applies activation 'id' in place to a whole layer output vector
+void activate (quint32 id, float* data, quint32 size, bool fast = false);
+
+}
+
+#endif // ACTIVATION_HPP
@@ -0,0 +1,100 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "compiledperceptron.hpp"
+
+namespace Neural_Network {
+
+void CompiledPerceptron::compile(const Perceptron &_percep) {
+	clear();
+	if (_percep.is_empty()) return;
+	inputsNum = _percep.inputs();
+	layersVec.resize(_percep.layers());
+	outputVec.resize(_percep.layers());
+	for (quint32 l = 0; l < _percep.layers(); ++l) {
+		Layer& layer = layersVec[l];
+		const quint32 neurons = _percep.neurons(l);
+		const quint32 weights = l ? _percep.neurons(l-1) : inputsNum;
+		layer.weights.resize(neurons, weights);
+		layer.bias.resize(neurons);
+		layer.neuronActivation.resize(neurons);
+		for (quint32 n = 0; n < neurons; ++n) {
+			assert(_percep.weights(l, n) == weights);
+			layer.weights.row(n) = Eigen::Map<const Eigen::RowVectorXf> (_percep.get_weights(l, n).data(), weights);
+			layer.bias[n] = _percep.get_const(l, n);
+			layer.neuronActivation[n] = _percep.get_func_id(l, n);
+		}
+		layer.activation = layer.neuronActivation[0];
+		for (quint32 n = 1; n < neurons; ++n) if (layer.neuronActivation[n] != layer.activation) {
+			layer.activation = MIXED_ID;
+			break;
+		}
+		if (layer.activation != MIXED_ID) layer.neuronActivation.clear();
+		outputVec[l].resize(neurons);
+	}
+}
+
+// '_out' holds whole samples, element i belongs to neuron i % neurons
+void CompiledPerceptron::activate(const Layer &_layer, float *_out, quint32 _size) const {
+	if (_layer.activation != MIXED_ID) Neural_Network::activate(_layer.activation, _out, _size, fastActivation);
+	else {
+		const quint32 neurons = _layer.neuronActivation.size();
+		for (quint32 i = 0; i < _size; ++i) _out[i] = activation_value(_layer.neuronActivation[i % neurons], _out[i]);
+	}
+}
+
+void CompiledPerceptron::work(const float *_input) {
+	Eigen::Map<const Eigen::VectorXf> in (_input, inputsNum);
+	for (quint32 l = 0; l < layersVec.size(); ++l) {
+		const Layer& layer = layersVec[l];
+		Eigen::VectorXf& out = outputVec[l];
+		if (l) out.noalias() = layer.weights * outputVec[l-1];
+		else out.noalias() = layer.weights * in;
+		out += layer.bias;
+		activate(layer, out.data(), out.size());
+	}
+}
+
+const Eigen::MatrixXf& CompiledPerceptron::work_batch(const Eigen::MatrixXf &_input) {
+	if (is_empty()) {
+		batchVec.resize(1);
+		batchVec[0].setZero(1, _input.cols());
+		return batchVec[0];
+	}
+	assert(_input.rows() == inputsNum);
+	batchVec.resize(layersVec.size());
+	for (quint32 l = 0; l < layersVec.size(); ++l) {
+		const Layer& layer = layersVec[l];
+		Eigen::MatrixXf& out = batchVec[l];
+		if (l) out.noalias() = layer.weights * batchVec[l-1];
+		else out.noalias() = layer.weights * _input;
+		out.colwise() += layer.bias;
+		activate(l, out);
+	}
+	return batchVec.back();
+}
+
+void CompiledPerceptron::activate(quint32 _layer, Eigen::MatrixXf &_out) const {
+	assert(_out.rows() == layersVec[_layer].bias.size());
+	activate(layersVec[_layer], _out.data(), _out.size());
+}
+
+}
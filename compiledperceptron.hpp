@@ -0,0 +1,89 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef COMPILEDPERCEPTRON_HPP
+#define COMPILEDPERCEPTRON_HPP
+
+#include "perceptron.hpp"
+#include "Eigen/Core"
+
+namespace Neural_Network {
+
+// Inference-only copy of a Perceptron. Every layer is stored as a contiguous
+// row-major weight matrix with a bias vector, so a layer is one GEMV followed
+// by a vectorised activation (activation.hpp) over the whole output vector. work_batch evaluates
+// an inputs x B matrix of samples, one per column, as one GEMM per layer.
+
+class CompiledPerceptron {
+
+	public:
+
+		typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> WeightMatrix;
+
+		// Layer activation: one of Activation_Functions_IDs, or MIXED_ID if
+		// the neurons of the layer do not share a function.
+		static const quint32 MIXED_ID = 0xFFFFFFFF;
+
+	private:
+
+		struct Layer {
+			WeightMatrix weights;
+			Eigen::VectorXf bias;
+			quint32 activation;
+			std::vector<quint32> neuronActivation;
+		};
+
+		std::vector<Layer> layersVec;
+		std::vector<Eigen::VectorXf> outputVec;
+		std::vector<Eigen::MatrixXf> batchVec;
+		quint32 inputsNum = 0;
+		bool fastActivation = false;
+
+		void activate (const Layer& _layer, float* _out, quint32 _size) const;
+
+	public:
+
+		CompiledPerceptron() {}
+		explicit CompiledPerceptron(const Perceptron& _percep) { compile(_percep); }
+		void compile (const Perceptron& _percep);
+		void clear () { layersVec.clear(); outputVec.clear(); batchVec.clear(); inputsNum = 0; }
+		void work (const float* _input);
+		const Eigen::MatrixXf& work_batch (const Eigen::MatrixXf& _input);
+		float get_output (quint32 _index) const { if (layersVec.empty()) return 0.f; else return outputVec.back()[_index]; }
+		quint32 inputs () const { return inputsNum; }
+		quint32 outputs () const { return layersVec.empty() ? 0 : layersVec.back().bias.size(); }
+		quint32 layers () const { return layersVec.size(); }
+		quint32 get_activation (quint32 _layer) const { return layersVec[_layer].activation; }
+		const WeightMatrix& get_weights (quint32 _layer) const { return layersVec[_layer].weights; }
+		const Eigen::VectorXf& get_bias (quint32 _layer) const { return layersVec[_layer].bias; }
+		// Layer outputs of the last work_batch call
+		const Eigen::MatrixXf& get_batch_output (quint32 _layer) const { return batchVec[_layer]; }
+		// Applies the activation of '_layer' to its pre-activations, one sample per column
+		void activate (quint32 _layer, Eigen::MatrixXf& _out) const;
+		bool is_empty () const { return layersVec.empty(); }
+		// Bounded-error approximations of the activations, see FastActivationError
+		void set_fast_activation (bool _fast) { fastActivation = _fast; }
+		bool get_fast_activation () const { return fastActivation; }
+};
+
+}
+
+#endif // COMPILEDPERCEPTRON_HPP
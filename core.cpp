@@ -35,6 +35,7 @@ Core::Core(quint32 dataSize, quint32 spectrumSize, MainWindow* _parent) : QObjec
 	IPolation = new InterpolationClass ();
 	filtProc = new FilteringProcessor (dataSize);
 	pulProc = new PulseProcessing (spectrumSize);
+	noiseMon = new NoiseMonitor ();
 
 	set_audio_channels(1);
 	set_uart_channels(1);
@@ -67,6 +68,7 @@ Core::~Core() {
 	delete filtProc;
 	delete IPolation;
 	delete pulProc;
+	delete noiseMon;
 }
 
 void Core::start() {
@@ -139,6 +141,7 @@ void Core::update_channels() {
 	while (inputsName.size() > num) inputsName.pop_back();
 	filtProc->set_streams(num);
 	IPolation->set_inputs(num);
+	noiseMon->set_streams(num);
 }
 
 void Core::set_buffer_size(quint32 size) {
@@ -257,15 +260,21 @@ void Core::filt_finished() {
 		else filterData[n] = rawData[n];
 		IPolation->set_input(filterData[n], n);
 	}
+	noiseMon->feed(rawData, filterData);
 	IPolation->start();
 	inter_finished();
 }
 
 void Core::inter_finished() {
-	for (quint32 n = 0; n < filtProc->get_streams(); n++)
-		if (IPolation->get_inter_enabled()) outputData[n] = IPolation->get_output(n);
+	bool lazy = IPolation->get_inter_enabled() && IPolation->get_inter_lazy();
+	std::vector<quint32> decimations (filtProc->get_streams());
+	for (quint32 n = 0; n < filtProc->get_streams(); n++) {
+		if (IPolation->get_inter_enabled() && !lazy) outputData[n] = IPolation->get_output(n);
 		else outputData[n] = filterData[n];
-	pulProc->set_inputs(outputData);
+		decimations[n] = filtProc->get_decimation(n);
+	}
+	pulProc->set_local_interpolator(lazy ? IPolation->get_local_interpolator() : std::shared_ptr<const Interpolator> ());
+	pulProc->set_inputs(outputData, decimations);
 	pulProc->process();
 	proc_finished();
 }
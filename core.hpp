@@ -27,6 +27,7 @@
 #include "interpolator.hpp"
 #include "filtering.hpp"
 #include "processing.hpp"
+#include "noisemonitor.hpp"
 
 class MainWindow;
 
@@ -39,6 +40,7 @@ class Core : public QObject {
 		FilteringProcessor* filtProc;
 		InterpolationClass * IPolation;
 		PulseProcessing* pulProc;
+		NoiseMonitor* noiseMon;
 
 		MainWindow * mainWinPtr;
 
@@ -79,6 +81,11 @@ class Core : public QObject {
 			{ ADClass->set_sample_rate(sampleRate); }
 		quint32 get_sample_rate () const
 			{ return ADClass->get_sample_rate(); }
+		// Rate of the data reaching interpolation and pulse processing, pulseSize
+		// and other settings in samples are counted at this rate. They are not
+		// rescaled when the decimation changes, FilteringDialog only warns.
+		quint32 get_effective_sample_rate (quint32 input) const
+			{ return get_sample_rate()/filtProc->get_decimation(input); }
 
 		void set_buffer_size (quint32 size);
 
@@ -189,6 +196,10 @@ class Core : public QObject {
 			{ return IPolation->get_inter_enabled(); }
 		void set_inter_enabled (bool enable)
 			{ IPolation->set_inter_enabled(enable); }
+		bool get_inter_lazy () const
+			{ return IPolation->get_inter_lazy(); }
+		void set_inter_lazy (bool lazy)
+			{ IPolation->set_inter_lazy(lazy); }
 
 		/*   FILTERING   */
 
@@ -217,6 +228,35 @@ class Core : public QObject {
 		std::shared_ptr<Filter::FilterSettings> filter_get (quint32 input, quint32 filter)
 			{ return filtProc->get(input, filter); }
 
+		/*   NOISE MONITOR   */
+
+		// stage is NoiseMonitor::Raw or NoiseMonitor::Filtered
+		std::vector<float> get_noise_psd (quint32 input, quint32 stage) const
+			{ return noiseMon->get_psd(input, stage); }
+
+		void set_noise_enabled (bool state)
+			{ noiseMon->set_enabled(state); }
+		bool get_noise_enabled () const
+			{ return noiseMon->get_enabled(); }
+
+		void set_noise_averages (quint32 count)
+			{ noiseMon->set_averages(count); }
+		quint32 get_noise_averages () const
+			{ return noiseMon->get_averages(); }
+
+		void set_noise_interval (quint32 buffers)
+			{ noiseMon->set_interval(buffers); }
+		quint32 get_noise_interval () const
+			{ return noiseMon->get_interval(); }
+
+		void set_noise_segment_size (quint32 size)
+			{ noiseMon->set_segment_size(size); }
+		quint32 get_noise_segment_size () const
+			{ return noiseMon->get_segment_size(); }
+
+		void noise_reset ()
+			{ noiseMon->reset(); }
+
 		/*   PROCESSING   */
 
 		void set_process_threads (quint32 threads)
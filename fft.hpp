@@ -19,39 +19,274 @@
 
 */
 
+
 #ifndef FTT_HPP
 #define FTT_HPP
 
 #include <complex>
 #include <cmath>
 #include <cassert>
+#include <cstdint>
 #include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FFT_X86_SIMD
+#include <immintrin.h>
+#endif
 
 const double PI = 3.141592653;
 
+// Power of two transforms, in place, with the sign convention FFT<T> has
+// always used: forward is X[k] = sum x[n]*exp(+2*pi*i*k*n/N), inverse is
+// scaled by 1/N. Bit reversal is done by swaps, then radix-4 stages and a
+// final radix-2 stage for odd powers of two. Twiddles of every radix-4
+// stage are stored as three contiguous runs W^k, W^2k, W^3k.
 
-template <typename T> class FFT {
+template <typename T> static inline std::complex<T> fft_mul (const std::complex<T>& a, const std::complex<T>& b) {
+	return std::complex<T> (a.real()*b.real() - a.imag()*b.imag(), a.real()*b.imag() + a.imag()*b.real());
+}
+
+template <typename T> static void fft_radix4_stage (std::complex<T>* data, uint32_t size, uint32_t L,
+													const std::complex<T>* w, bool inverse) {
+	if (L == 1) {
+		// Twiddles are all 1
+		for (uint32_t base = 0; base < size; base += 4) {
+			std::complex<T>* d = data + base;
+			std::complex<T> s02 = d[0] + d[1], d02 = d[0] - d[1], s13 = d[2] + d[3], d13 = d[2] - d[3];
+			std::complex<T> rot = inverse ? std::complex<T> (d13.imag(), -d13.real()) : std::complex<T> (-d13.imag(), d13.real());
+			d[0] = s02 + s13;
+			d[1] = d02 + rot;
+			d[2] = s02 - s13;
+			d[3] = d02 - rot;
+		}
+		return;
+	}
+	for (uint32_t base = 0; base < size; base += 4*L) {
+		std::complex<T>* d = data + base;
+		for (uint32_t k = 0; k < L; k++) {
+			std::complex<T> w1 = w[k], w2 = w[L + k], w3 = w[2*L + k];
+			if (inverse) { w1 = std::conj(w1); w2 = std::conj(w2); w3 = std::conj(w3); }
+			// Inputs come in bit reversed order: offsets 0, 2, 1, 3 of the 4L sequence
+			std::complex<T> t0 = d[k], t1 = fft_mul(d[L + k], w2), t2 = fft_mul(d[2*L + k], w1), t3 = fft_mul(d[3*L + k], w3);
+			std::complex<T> s02 = t0 + t1, d02 = t0 - t1, s13 = t2 + t3, d13 = t2 - t3;
+			std::complex<T> rot = inverse ? std::complex<T> (d13.imag(), -d13.real()) : std::complex<T> (-d13.imag(), d13.real());
+			d[k] = s02 + s13;
+			d[L + k] = d02 + rot;
+			d[2*L + k] = s02 - s13;
+			d[3*L + k] = d02 - rot;
+		}
+	}
+}
+
+// Last stage of odd powers of two, joins the two halves
+template <typename T> static void fft_radix2_stage (std::complex<T>* data, uint32_t L, const std::complex<T>* w, bool inverse) {
+	for (uint32_t k = 0; k < L; k++) {
+		std::complex<T> t = fft_mul(data[L + k], inverse ? std::conj(w[k]) : w[k]);
+		data[L + k] = data[k] - t;
+		data[k] += t;
+	}
+}
+
+template <typename T> static inline bool fft_simd_supported (T*) { return false; }
+template <typename T> static inline void fft_radix4_simd (std::complex<T>*, uint32_t, uint32_t, const std::complex<T>*, bool) { assert(false); }
+template <typename T> static inline void fft_radix2_simd (std::complex<T>*, uint32_t, const std::complex<T>*, bool) { assert(false); }
+
+#ifdef FFT_X86_SIMD
+static inline bool fft_simd_supported (float*) {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx");
+}
+
+__attribute__((target("avx")))
+static inline __m256 fft_cmul_avx (__m256 a, __m256 w) {
+	return _mm256_addsub_ps(_mm256_mul_ps(a, _mm256_moveldup_ps(w)),
+							_mm256_mul_ps(_mm256_permute_ps(a, 0xB1), _mm256_movehdup_ps(w)));
+}
+
+// Four butterflies per iteration, L is a multiple of 4
+__attribute__((target("avx")))
+static inline void fft_radix4_simd (std::complex<float>* data, uint32_t size, uint32_t L, const std::complex<float>* w, bool inverse) {
+	const __m256 imagSign = _mm256_setr_ps(0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f);
+	const __m256 realSign = _mm256_setr_ps(-0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f);
+	const __m256 conjMask = inverse ? imagSign : _mm256_setzero_ps();
+	const __m256 rotMask = inverse ? imagSign : realSign;
+	const float* w1p = (const float*)w;
+	const float* w2p = (const float*)(w + L);
+	const float* w3p = (const float*)(w + 2*L);
+	for (uint32_t base = 0; base < size; base += 4*L) {
+		float* p0 = (float*)(data + base);
+		float* p1 = (float*)(data + base + L);
+		float* p2 = (float*)(data + base + 2*L);
+		float* p3 = (float*)(data + base + 3*L);
+		for (uint32_t k = 0; k < 2*L; k += 8) {
+			__m256 w1 = _mm256_xor_ps(_mm256_loadu_ps(w1p + k), conjMask);
+			__m256 w2 = _mm256_xor_ps(_mm256_loadu_ps(w2p + k), conjMask);
+			__m256 w3 = _mm256_xor_ps(_mm256_loadu_ps(w3p + k), conjMask);
+			__m256 t0 = _mm256_loadu_ps(p0 + k);
+			__m256 t1 = fft_cmul_avx(_mm256_loadu_ps(p1 + k), w2);
+			__m256 t2 = fft_cmul_avx(_mm256_loadu_ps(p2 + k), w1);
+			__m256 t3 = fft_cmul_avx(_mm256_loadu_ps(p3 + k), w3);
+			__m256 s02 = _mm256_add_ps(t0, t1), d02 = _mm256_sub_ps(t0, t1);
+			__m256 s13 = _mm256_add_ps(t2, t3), d13 = _mm256_sub_ps(t2, t3);
+			__m256 rot = _mm256_xor_ps(_mm256_permute_ps(d13, 0xB1), rotMask);
+			_mm256_storeu_ps(p0 + k, _mm256_add_ps(s02, s13));
+			_mm256_storeu_ps(p1 + k, _mm256_add_ps(d02, rot));
+			_mm256_storeu_ps(p2 + k, _mm256_sub_ps(s02, s13));
+			_mm256_storeu_ps(p3 + k, _mm256_sub_ps(d02, rot));
+		}
+	}
+}
+
+__attribute__((target("avx")))
+static inline void fft_radix2_simd (std::complex<float>* data, uint32_t L, const std::complex<float>* w, bool inverse) {
+	const __m256 conjMask = inverse ? _mm256_setr_ps(0.f, -0.f, 0.f, -0.f, 0.f, -0.f, 0.f, -0.f) : _mm256_setzero_ps();
+	float* p0 = (float*)data;
+	float* p1 = (float*)(data + L);
+	for (uint32_t k = 0; k < 2*L; k += 8) {
+		__m256 t = fft_cmul_avx(_mm256_loadu_ps(p1 + k), _mm256_xor_ps(_mm256_loadu_ps((const float*)w + k), conjMask));
+		__m256 a = _mm256_loadu_ps(p0 + k);
+		_mm256_storeu_ps(p0 + k, _mm256_add_ps(a, t));
+		_mm256_storeu_ps(p1 + k, _mm256_sub_ps(a, t));
+	}
+}
+#endif
+
+template <typename T> class FFTPlan {
 
-		std::vector<std::complex<T>> dataMassTmp;
-		std::vector<std::complex<T>> expMassPlus;
-		std::vector<std::complex<T>> expMassMinus;
-		std::vector<uint32_t> bitReversMass;
 		uint32_t size;
-		uint32_t size2N;
+		uint32_t log2Size = 0;
+		std::vector<uint32_t> swaps;
+		std::vector<std::complex<T>> twiddles;
+		// exp(+2*pi*i*k/N) for the real transforms, which run on the half size plan
+		std::vector<std::complex<T>> realTwiddles;
+		std::shared_ptr<const FFTPlan> half;
+		bool useSIMD;
 
-		FFT(const FFT& _FFT) {
-			set_size(_FFT.size);
+		void transform (std::complex<T>* data, bool inverse) const {
+			for (uint32_t i = 0, ie = swaps.size(); i < ie; i += 2) std::swap(data[swaps[i]], data[swaps[i+1]]);
+			uint32_t L = 1;
+			const std::complex<T>* w = twiddles.data();
+			for (; 4*L <= size; L *= 4) {
+				if (useSIMD && L >= 4) fft_radix4_simd(data, size, L, w, inverse);
+				else fft_radix4_stage(data, size, L, w, inverse);
+				w += 3*L;
+			}
+			if (L < size) {
+				if (useSIMD && L >= 4) fft_radix2_simd(data, L, w, inverse);
+				else fft_radix2_stage(data, L, w, inverse);
+			}
+		}
+
+	public:
+
+		explicit FFTPlan (uint32_t _size) : size(_size) {
+			assert (size && !(size & (size - 1)));
+			while ((1u << log2Size) < size) ++log2Size;
+			for (uint32_t i = 0; i < size; i++) {
+				uint32_t r = 0;
+				for (uint32_t b = 0; b < log2Size; b++) r |= ((i >> b) & 1) << (log2Size - 1 - b);
+				if (i < r) { swaps.push_back(i); swaps.push_back(r); }
+			}
+			const double pi = std::acos(-1.);
+			uint32_t L = 1;
+			for (; 4*L <= size; L *= 4)
+				for (uint32_t p = 1; p <= 3; p++)
+					for (uint32_t k = 0; k < L; k++)
+						twiddles.push_back(std::complex<T> (std::polar(1., 2.*pi*p*k/(4.*L))));
+			for (uint32_t k = 0; L < size && k < L; k++)
+				twiddles.push_back(std::complex<T> (std::polar(1., 2.*pi*k/(2.*L))));
+			if (size >= 2) {
+				realTwiddles.resize(size/2);
+				for (uint32_t k = 0; k < size/2; k++) realTwiddles[k] = std::complex<T> (std::polar(1., 2.*pi*k/size));
+				half = get(size/2);
+			}
+			useSIMD = fft_simd_supported((T*)0);
 		}
+		FFTPlan (const FFTPlan&) = delete;
 
-		uint32_t bitreverse (uint32_t x, uint8_t _size) {
-			x = ((x & 0x55555555) << 1) | ((x >> 1) & 0x55555555);
-			x = ((x & 0x33333333) << 2) | ((x >> 2) & 0x33333333);
-			x = ((x & 0x0F0F0F0F) << 4) | ((x >> 4) & 0x0F0F0F0F);
-			x = (x <<24) | ((x & 0xFF00) <<8) | ((x >> 8) & 0xFF00) | (x >> 24);
-			x >>= (uint8_t)32 - _size;
-			return x;
+		// Plans are built once per size and shared
+		static std::shared_ptr<const FFTPlan> get (uint32_t size) {
+			static std::map<uint32_t, std::shared_ptr<const FFTPlan>> cache;
+			static std::mutex mutex;
+			{
+				std::lock_guard<std::mutex> lock (mutex);
+				auto a = cache.find(size);
+				if (a != cache.end()) return a->second;
+			}
+			std::shared_ptr<const FFTPlan> plan (new FFTPlan (size));
+			std::lock_guard<std::mutex> lock (mutex);
+			return cache.insert(std::make_pair(size, plan)).first->second;
 		}
 
+		uint32_t get_size () const { return size; }
+
+		// Batch calls transform 'count' consecutive blocks
+		void forward (std::complex<T>* data, uint32_t count = 1) const {
+			for (uint32_t c = 0; c < count; c++) transform(data + c*size, false);
+		}
+
+		void inverse (std::complex<T>* data, uint32_t count = 1) const {
+			const T norm = T(1)/size;
+			for (uint32_t c = 0; c < count; c++) {
+				std::complex<T>* d = data + c*size;
+				transform(d, true);
+				for (uint32_t i = 0; i < size; i++) d[i] *= norm;
+			}
+		}
+
+		// size real samples to size/2 + 1 bins, the rest of the spectrum is
+		// conjugate symmetric. in and out may not overlap.
+		void forward_real (const T* in, std::complex<T>* out, uint32_t count = 1) const {
+			assert (size >= 2);
+			const uint32_t M = size/2;
+			for (uint32_t c = 0; c < count; c++) {
+				const T* x = in + c*size;
+				std::complex<T>* z = out + c*(M + 1);
+				// Even samples as real parts, odd as imaginary
+				for (uint32_t n = 0; n < M; n++) z[n] = std::complex<T> (x[2*n], x[2*n+1]);
+				half->transform(z, false);
+				T r0 = z[0].real(), i0 = z[0].imag();
+				z[0] = std::complex<T> (r0 + i0, 0);
+				z[M] = std::complex<T> (r0 - i0, 0);
+				// X[k] = E[k] + W^k*O[k], E and O are the transforms of even and odd samples
+				for (uint32_t k = 1, ke = M/2; k <= ke; k++) {
+					std::complex<T> a = z[k], b = std::conj(z[M - k]);
+					std::complex<T> ev = (a + b)*T(0.5), od = a - b;
+					od = std::complex<T> (od.imag()*T(0.5), -od.real()*T(0.5));
+					std::complex<T> ev2 = std::conj(ev), od2 = std::conj(od);
+					z[k] = ev + fft_mul(realTwiddles[k], od);
+					z[M - k] = ev2 + fft_mul(realTwiddles[M - k], od2);
+				}
+			}
+		}
+
+		// size/2 + 1 bins to size real samples, scaled by 1/size
+		void inverse_real (const std::complex<T>* in, T* out, uint32_t count = 1) const {
+			assert (size >= 2);
+			const uint32_t M = size/2;
+			for (uint32_t c = 0; c < count; c++) {
+				const std::complex<T>* X = in + c*(M + 1);
+				std::complex<T>* z = (std::complex<T>*)(out + c*size);
+				for (uint32_t k = 0; k < M; k++) {
+					std::complex<T> a = X[k], b = std::conj(X[M - k]);
+					std::complex<T> ev = (a + b)*T(0.5);
+					std::complex<T> od = fft_mul((a - b)*T(0.5), std::conj(realTwiddles[k]));
+					z[k] = ev + std::complex<T> (-od.imag(), od.real());
+				}
+				half->inverse(z);
+			}
+		}
+};
+
+template <typename T> class FFT {
+
+		std::shared_ptr<const FFTPlan<T>> plan;
+		std::vector<T> realMass;
+		bool realInput = false;
+		uint32_t size = 0;
+
 	protected:
 
 
@@ -61,35 +296,19 @@ template <typename T> class FFT {
 	public:
 
 		FFT(uint32_t _size) { set_size(_size); }
+		FFT(const FFT& _FFT) : plan(_FFT.plan), realMass(_FFT.realMass), realInput(_FFT.realInput), size(_FFT.size),
+			dataMass(_FFT.dataMass), freqMass(_FFT.freqMass) {}
 		virtual ~FFT () {}
 
 		void set_size (uint32_t _size) {
 			if (size == _size) return;
+			assert (_size && !(_size & (_size - 1)));
 			size = _size;
-			uint32_t sizeTmp (size);
-			size2N = 1;
-			while ((sizeTmp /= 2) != 1) {
-				assert (size % sizeTmp == 0 && size != 0);
-				++size2N;
-			}
-
-			dataMass.resize(size);
-			dataMassTmp.resize(size);
-			freqMass.resize(size);
-			expMassPlus.resize(size/2);
-			expMassMinus.resize(size/2);
-			bitReversMass.resize(size);
-
-			for (uint32_t i = 0; i < size/2; i++) {
-				expMassPlus[i] = exp(std::complex<float> (0.0, 2.0f * PI * static_cast<float> (i) / static_cast<float> (size)));
-				expMassMinus[i] = exp(std::complex<float> (0.0, -2.0f * PI * static_cast<float> (i) / static_cast<float> (size)));
-			}
-			for (uint32_t i = 0; i < size; i++) {
-				dataMass[i] = std::complex<float> (0.f, 0.f);
-				dataMassTmp[i] = std::complex<float> (0.f, 0.f);
-				freqMass[i] = std::complex<float> (1.f, 0.f);
-				bitReversMass[i] = bitreverse(i, size2N);
-			}
+			plan = FFTPlan<T>::get(size);
+			dataMass.assign(size, std::complex<T> (0, 0));
+			freqMass.assign(size, std::complex<T> (1, 0));
+			realMass.clear();
+			realInput = false;
 		}
 
 		uint32_t data_size () const { return size; }
@@ -97,14 +316,17 @@ template <typename T> class FFT {
 
 		void set_time_data (const std::vector<T>& inp) {
 			assert(inp.size() == dataMass.size());
+			realMass = inp;
 			for (uint32_t i = 0; i < size; ++i) {
 				dataMass[i] = inp[i];
 			}
+			realInput = true;
 		}
 
 		void set_time_data (const std::vector<std::complex<T>>& inp) {
 			assert(inp.size() == dataMass.size());
 			dataMass = inp;
+			realInput = false;
 		}
 
 		void set_freq_data (const std::vector<std::complex<T>>& freq) {
@@ -139,42 +361,16 @@ template <typename T> class FFT {
 
 		void go (bool inverse = false) {
 			if (inverse) {
-				T szf = static_cast<T> (size);
-				for (uint32_t i = 0; i < size; ++i) dataMass[i] = (freqMass[bitReversMass[i]]/szf);
-				for (uint32_t stage = 1; stage != size; stage *= 2) {
-					for (uint32_t j = 0, n = size/(2*stage); j < n; ++j) {
-						uint32_t t1 = (j * 2) * stage;
-						uint32_t t2 = t1 + stage;
-						for (uint32_t i = 0; i < stage; ++i) {
-							dataMass[i + t2] *= expMassMinus[i * n];
-						}
-						for (uint32_t i = 0; i < stage; ++i) {
-							uint32_t t3 = i + t1;
-							uint32_t t4 = i + t2;
-							dataMassTmp[t3] = dataMass[t3] + dataMass[t4];
-							dataMassTmp[t4] = dataMass[t3] - dataMass[t4];
-						}
-					}
-					std::swap (dataMass, dataMassTmp);
-				}
+				dataMass = freqMass;
+				plan->inverse(dataMass.data());
+				realInput = false;
+			} else if (realInput && size >= 4) {
+				// Real input runs as a half size complex transform
+				plan->forward_real(realMass.data(), freqMass.data());
+				for (uint32_t k = 1; k < size/2; k++) freqMass[size - k] = std::conj(freqMass[k]);
 			} else {
-				for (uint32_t i = 0; i < size; ++i) freqMass[i] = (dataMass[bitReversMass[i]]);
-				for (uint32_t stage = 1; stage != size; stage *= 2) {
-					for (uint32_t j = 0, n = size/(2*stage); j < n; ++j) {
-						uint32_t t1 = (j * 2) * stage;
-						uint32_t t2 = t1 + stage;
-						for (uint32_t i = 0; i < stage; ++i) {
-							freqMass[i + t2] *= expMassPlus[i * n];
-						}
-						for (uint32_t i = 0; i < stage; ++i) {
-							uint32_t t3 = i + t1;
-							uint32_t t4 = i + t2;
-							dataMassTmp[t3] = freqMass[t3] + freqMass[t4];
-							dataMassTmp[t4] = freqMass[t3] - freqMass[t4];
-						}
-					}
-					std::swap (freqMass, dataMassTmp);
-				}
+				freqMass = dataMass;
+				plan->forward(freqMass.data());
 			}
 		}
 };
@@ -20,19 +20,247 @@
 */
 
 #include "filtering.hpp"
+#include <chrono>
+#include <limits>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHAPER_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Direct convolution over a contiguous [history | input] staging buffer.
+// SIMD variants run over output samples and keep the per-output summation
+// order of the scalar loop. Their remainders use scalar FMA, so an output
+// does not depend on where it falls in the buffer.
+
+typedef void (*ConvolveFunc) (const float*, const float*, quint32, float*, quint32);
+
+static void convolve_direct (const float* staged, const float* shape, quint32 sz, float* out, quint32 size) {
+	for (quint32 i = 0; i < size; i++) {
+		out[i] = 0;
+		for (quint32 n = 0; n < sz; n++) out[i] += staged[n + i]*shape[n];
+	}
+}
 
-void Shaper::process() {
-	quint32 sz = shape.size();
-	for(quint32 i = 0; i < sz; i++) {
-		output[i] = 0;
-		for (quint32 n = i; n < sz; n++) output[i] += buffer[n]*shape[n - i];
-		for (quint32 n = 0; n < i; n++) output[i] += (*inputPtr)[n]*shape[n + sz - i];
+#ifdef SHAPER_X86_SIMD
+__attribute__((target("fma")))
+static void convolve_direct_fma (const float* staged, const float* shape, quint32 sz, float* out, quint32 size) {
+	for (quint32 i = 0; i < size; i++) {
+		float acc = 0;
+		for (quint32 n = 0; n < sz; n++) acc = __builtin_fmaf(staged[n + i], shape[n], acc);
+		out[i] = acc;
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void convolve_direct_avx2 (const float* staged, const float* shape, quint32 sz, float* out, quint32 size) {
+	quint32 i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+		__m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+		for (quint32 n = 0; n < sz; n++) {
+			const float* src = staged + n + i;
+			__m256 k = _mm256_set1_ps(shape[n]);
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(src     ), k, acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(src +  8), k, acc1);
+			acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(src + 16), k, acc2);
+			acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(src + 24), k, acc3);
+		}
+		_mm256_storeu_ps(out + i     , acc0);
+		_mm256_storeu_ps(out + i +  8, acc1);
+		_mm256_storeu_ps(out + i + 16, acc2);
+		_mm256_storeu_ps(out + i + 24, acc3);
+	}
+	for (; i + 8 <= size; i += 8) {
+		__m256 acc = _mm256_setzero_ps();
+		for (quint32 n = 0; n < sz; n++)
+			acc = _mm256_fmadd_ps(_mm256_loadu_ps(staged + n + i), _mm256_set1_ps(shape[n]), acc);
+		_mm256_storeu_ps(out + i, acc);
+	}
+	convolve_direct_fma(staged + i, shape, sz, out + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+static void convolve_direct_avx512 (const float* staged, const float* shape, quint32 sz, float* out, quint32 size) {
+	quint32 i = 0;
+	for (; i + 64 <= size; i += 64) {
+		__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+		__m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+		for (quint32 n = 0; n < sz; n++) {
+			const float* src = staged + n + i;
+			__m512 k = _mm512_set1_ps(shape[n]);
+			acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(src     ), k, acc0);
+			acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(src + 16), k, acc1);
+			acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(src + 32), k, acc2);
+			acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(src + 48), k, acc3);
+		}
+		_mm512_storeu_ps(out + i     , acc0);
+		_mm512_storeu_ps(out + i + 16, acc1);
+		_mm512_storeu_ps(out + i + 32, acc2);
+		_mm512_storeu_ps(out + i + 48, acc3);
+	}
+	for (; i + 16 <= size; i += 16) {
+		__m512 acc = _mm512_setzero_ps();
+		for (quint32 n = 0; n < sz; n++)
+			acc = _mm512_fmadd_ps(_mm512_loadu_ps(staged + n + i), _mm512_set1_ps(shape[n]), acc);
+		_mm512_storeu_ps(out + i, acc);
+	}
+	convolve_direct_fma(staged + i, shape, sz, out + i, size - i);
+}
+#endif
+
+static ConvolveFunc select_convolve () {
+#ifdef SHAPER_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return &convolve_direct_avx512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return &convolve_direct_avx2;
+#endif
+	return &convolve_direct;
+}
+
+static const ConvolveFunc convolve = select_convolve();
+
+// Moving average as a running sum: out[i] = (S[i+sz] - S[i])/sz, where S is
+// the prefix sum of the staged buffer. Accumulation is done in double and
+// restarts from the history window on every call, so the rounding error
+// does not grow from buffer to buffer.
+
+typedef void (*RunningMeanFunc) (const float*, quint32, float*, quint32);
+
+static void running_mean_direct (const float* staged, quint32 sz, float* out, quint32 size) {
+	const double norm = 1./sz;
+	double sum = 0.;
+	for (quint32 n = 0; n < sz; n++) sum += staged[n];
+	for (quint32 i = 0; i < size; i++) {
+		out[i] = sum*norm;
+		sum += (double)staged[i + sz] - (double)staged[i];
+	}
+}
+
+#ifdef SHAPER_X86_SIMD
+__attribute__((target("avx2")))
+static void running_mean_avx2 (const float* staged, quint32 sz, float* out, quint32 size) {
+	const __m256d norm = _mm256_set1_pd(1./sz);
+	const __m256d zero = _mm256_setzero_pd();
+	double sum = 0.;
+	for (quint32 n = 0; n < sz; n++) sum += staged[n];
+	__m256d carry = _mm256_set1_pd(sum);
+	quint32 i = 0;
+	for (; i + 4 <= size; i += 4) {
+		__m256d d = _mm256_sub_pd(_mm256_cvtps_pd(_mm_loadu_ps(staged + i + sz)),
+								  _mm256_cvtps_pd(_mm_loadu_ps(staged + i)));
+		// In-register inclusive scan of the four differences
+		__m256d scan = _mm256_add_pd(d, _mm256_blend_pd(_mm256_permute4x64_pd(d, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1));
+		scan = _mm256_add_pd(scan, _mm256_blend_pd(_mm256_permute4x64_pd(scan, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x3));
+		__m256d mean = _mm256_mul_pd(_mm256_add_pd(carry, _mm256_sub_pd(scan, d)), norm);
+		_mm_storeu_ps(out + i, _mm256_cvtpd_ps(mean));
+		carry = _mm256_add_pd(carry, _mm256_permute4x64_pd(scan, _MM_SHUFFLE(3, 3, 3, 3)));
+	}
+	sum = _mm_cvtsd_f64(_mm256_castpd256_pd128(carry));
+	for (; i < size; i++) {
+		out[i] = sum*(1./sz);
+		sum += (double)staged[i + sz] - (double)staged[i];
+	}
+}
+#endif
+
+static RunningMeanFunc select_running_mean () {
+#ifdef SHAPER_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return &running_mean_avx2;
+#endif
+	return &running_mean_direct;
+}
+
+static const RunningMeanFunc running_mean = select_running_mean();
+
+void FFTConvolver::set_kernel(const std::vector<float>& shape) {
+	kernelSize = shape.size();
+	quint32 fftSize = 64;
+	while (fftSize < 4*(kernelSize + 1)) fftSize *= 2;
+	blockSize = fftSize - kernelSize;
+	plan = FFTPlan<float>::get(fftSize);
+	// Shaper output i is sum(shape[n]*x[i - sz + n]), i.e. convolution with
+	// the reversed shape delayed by one sample.
+	frames.assign(fftSize, 0.f);
+	for (quint32 m = 1; m <= kernelSize; m++) frames[m] = shape[kernelSize - m];
+	kernelSpectrum.resize(fftSize/2 + 1);
+	plan->forward_real(frames.data(), kernelSpectrum.data());
+}
+
+void FFTConvolver::process(const float* staged, float* out, quint32 size) {
+	// All overlapping frames of the buffer go through one batch of transforms
+	const quint32 fftSize = plan->get_size(), bins = fftSize/2 + 1;
+	const quint32 count = (size + blockSize - 1)/blockSize;
+	frames.resize(count*fftSize);
+	spectra.resize(count*bins);
+	for (quint32 c = 0; c < count; c++) {
+		quint32 beg = c*blockSize;
+		quint32 avail = std::min<quint32> (fftSize, size + kernelSize - beg);
+		memcpy(frames.data() + c*fftSize, staged + beg, sizeof(float)*avail);
+		std::fill(frames.begin() + c*fftSize + avail, frames.begin() + (c + 1)*fftSize, 0.f);
+	}
+	plan->forward_real(frames.data(), spectra.data(), count);
+	for (quint32 c = 0; c < count; c++) {
+		std::complex<float>* spec = spectra.data() + c*bins;
+		for (quint32 k = 0; k < bins; k++) spec[k] = fft_mul(spec[k], kernelSpectrum[k]);
+	}
+	plan->inverse_real(spectra.data(), frames.data(), count);
+	for (quint32 c = 0; c < count; c++) {
+		quint32 beg = c*blockSize;
+		memcpy(out + beg, frames.data() + c*fftSize + kernelSize, sizeof(float)*std::min(blockSize, size - beg));
 	}
-	for(int i = sz, ie = output.size(); i < ie; i++) {
-		output[i] = 0;
-		for (quint32 n = 0; n < sz; n++) output[i] += (*inputPtr)[n + i - sz]*shape[n];
+}
+
+quint32 Shaper::calibrate_fft_crossover() {
+	const quint32 size = 8192, maxKernel = 1024;
+	std::vector<float> staged (size + maxKernel), out (size);
+	for (quint32 i = 0; i < staged.size(); i++) staged[i] = std::sin(0.01f*i);
+	for (quint32 sz = 8; sz <= maxKernel; sz *= 2) {
+		std::vector<float> kernel (sz, 1.f/sz);
+		FFTConvolver conv;
+		conv.set_kernel(kernel);
+		const float* data = staged.data() + maxKernel - sz;
+		double directTime = 1.e10, fftTime = 1.e10;
+		for (quint32 rep = 0; rep < 3; rep++) {
+			auto t0 = std::chrono::steady_clock::now();
+			convolve(data, kernel.data(), sz, out.data(), size);
+			auto t1 = std::chrono::steady_clock::now();
+			conv.process(data, out.data(), size);
+			auto t2 = std::chrono::steady_clock::now();
+			directTime = std::min(directTime, std::chrono::duration<double> (t1 - t0).count());
+			fftTime = std::min(fftTime, std::chrono::duration<double> (t2 - t1).count());
+		}
+		if (fftTime < directTime) return sz;
 	}
-	memcpy (buffer.data(), (*inputPtr).data() + (*inputPtr).size() - sz, sizeof(float)*(sz));
+	return 2*maxKernel;
+}
+
+quint32 Shaper::fft_crossover() {
+	static const quint32 crossover = calibrate_fft_crossover();
+	return crossover;
+}
+
+void Shaper::shape_changed() {
+	useFFT = shape.size() >= fft_crossover();
+	if (useFFT) fftConv.set_kernel(shape);
+}
+
+void Shaper::stage_input() {
+	quint32 sz = buffer.size();
+	staging.resize(sz + output.size());
+	memcpy(staging.data(), buffer.data(), sizeof(float)*sz);
+	memcpy(staging.data() + sz, inputPtr->data(), sizeof(float)*output.size());
+}
+
+void Shaper::keep_history() {
+	memcpy (buffer.data(), staging.data() + output.size(), sizeof(float)*buffer.size());
+}
+
+void Shaper::process() {
+	stage_input();
+	if (useFFT) fftConv.process(staging.data(), output.data(), output.size());
+	else convolve(staging.data(), shape.data(), shape.size(), output.data(), output.size());
+	keep_history();
 }
 
 void Delay::set(std::shared_ptr<FilterSettings> settings) {
@@ -223,10 +451,11 @@ quint32 CR_IIR_Filter::get_filter_id () const {
 }
 
 void CR_IIR_Filter::process () {
-	output[0] = alpha*((*inputPtr)[0] + buffer[0]);
+	output[0] = alpha*((*inputPtr)[0] - buffer[0] + buffer[1]);
 	for (quint32 i = 1, ie = output.size(); i < ie; i++)
 		output[i] = alpha*((*inputPtr)[i] - (*inputPtr)[i-1] + output[i-1]);
-	buffer[0] = output[output.size()-1] - (*inputPtr)[(*inputPtr).size()-1];
+	buffer[0] = (*inputPtr)[(*inputPtr).size()-1];
+	buffer[1] = output[output.size()-1];
 }
 
 std::shared_ptr<Filter::FilterSettings> CR_REV_IIR_Filter::get() {
@@ -240,10 +469,11 @@ quint32 CR_REV_IIR_Filter::get_filter_id () const {
 }
 
 void CR_REV_IIR_Filter::process () {
-	output[0] = (*inputPtr)[0]/alpha + buffer[0];
+	output[0] = (*inputPtr)[0]/alpha - buffer[0] + buffer[1]*0.9999;
 	for (quint32 i = 1, ie = output.size(); i < ie; i++)
 		output[i] = (*inputPtr)[i]/alpha - (*inputPtr)[i-1] + output[i-1]*0.9999;
-	buffer[0] = output[output.size()-1]*0.9999 - (*inputPtr)[(*inputPtr).size()-1];
+	buffer[0] = (*inputPtr)[(*inputPtr).size()-1];
+	buffer[1] = output[output.size()-1];
 }
 
 void MovingAverage::set_shape() {
@@ -251,6 +481,15 @@ void MovingAverage::set_shape() {
 	buffer.resize(size);
 	for (quint32 i = 0; i < size; i++) shape[i] = 1.f/(float)size;
 }
+
+void MovingAverage::process() {
+	stage_input();
+	// Short windows are cheaper through the vectorised direct convolution
+	if (size <= directMaxSize) convolve(staging.data(), shape.data(), size, output.data(), output.size());
+	else running_mean(staging.data(), size, output.data(), output.size());
+	keep_history();
+}
+
 void MovingAverage::set(std::shared_ptr<FilterSettings> settings) {
 	size = ((Settings*)settings.get())->size;
 	set_shape();
@@ -287,6 +526,26 @@ void TrapezoidalShaper::set_shape() {
 	for (quint32 i = 0; i < sideSz; i++) shape[i] = (float)i/(float)sideSz;
 	for (quint32 i = sideSz, ie = i + flatSz; i < ie; i++) shape[i] = 1.f;
 	for (quint32 i = sideSz + flatSz, ie = i + sideSz; i < ie; i++) shape[i] = (float)(ie - i)/(float)sideSz;
+	inputDelay.assign(sideSz, 0.);
+	sumDelay.assign(sideSz + flatSz, 0.);
+	inputDelayPos = 0;
+	sumDelayPos = 0;
+	sideSum = 0.;
+	trapSum = 0.;
+}
+
+void TrapezoidalShaper::process() {
+	const double norm = 1./sideSz;
+	const float* in = inputPtr->data();
+	for (quint32 i = 0, ie = output.size(); i < ie; i++) {
+		output[i] = trapSum*norm;
+		sideSum += in[i] - inputDelay[inputDelayPos];
+		inputDelay[inputDelayPos] = in[i];
+		if (++inputDelayPos == inputDelay.size()) inputDelayPos = 0;
+		trapSum += sideSum - sumDelay[sumDelayPos];
+		sumDelay[sumDelayPos] = sideSum;
+		if (++sumDelayPos == sumDelay.size()) sumDelayPos = 0;
+	}
 }
 void TrapezoidalShaper::set(std::shared_ptr<FilterSettings> settings) {
 	sideSz = ((Settings*)settings.get())->side;
@@ -328,6 +587,7 @@ void GaussianShaper::set_shape() {
 	shape.resize(8*width);
 	buffer.resize(8*width);
 	for (qint32 i = 0, ie = shape.size(); i < ie; i++) shape[i] = std::exp(-(i - ie/2)*(i - ie/2)/(2.f*width*width));
+	shape_changed();
 }
 
 void GaussianShaper::set(std::shared_ptr<FilterSettings> settings) {
@@ -367,6 +627,7 @@ void CuspShaper::set_shape() {
 	for (qint32 i = 0; i < sideSz; i++) shape[i] = std::exp((i-sideSz)/width);
 	for (qint32 i = sideSz, ie = i + flatSz; i < ie; i++) shape[i] = 1.f;
 	for (qint32 i = sideSz + flatSz, ie = i + sideSz; i < ie; i++) shape[i] = std::exp((ie - i - sideSz)/width);
+	shape_changed();
 }
 
 void CuspShaper::set(std::shared_ptr<FilterSettings> settings) {
@@ -405,6 +666,672 @@ CuspShaper::Settings & CuspShaper::Settings::operator= (const FilterSettings& a)
 	return *this;
 }
 
+typedef std::complex<double> Complex;
+
+// Pairs z-plane roots into sections: conjugate pole pairs first, then real
+// poles two at a time. Zeros are real and are handed out in order.
+static std::vector<BiquadCascade::Section> zpk_to_sections (const std::vector<double>& zeros, const std::vector<Complex>& poles) {
+	std::vector<BiquadCascade::Section> res;
+	std::vector<double> realPoles;
+	quint32 zn = 0;
+	auto next_zero = [&] () { return zn < zeros.size() ? zeros[zn++] : 0.; };
+	for (auto& p: poles) {
+		if (std::fabs(p.imag()) < 1.e-9) realPoles.push_back(p.real());
+		else if (p.imag() > 0.) {
+			double z1 = next_zero(), z2 = next_zero();
+			res.push_back({1., -(z1 + z2), z1*z2, -2.*p.real(), std::norm(p)});
+		}
+	}
+	for (quint32 i = 0; i < realPoles.size(); i += 2) {
+		if (i + 1 < realPoles.size()) {
+			double z1 = next_zero(), z2 = next_zero();
+			res.push_back({1., -(z1 + z2), z1*z2, -(realPoles[i] + realPoles[i+1]), realPoles[i]*realPoles[i+1]});
+		}
+		else res.push_back({1., -next_zero(), 0., -realPoles[i], 0.});
+	}
+	return res;
+}
+
+// Bilinear transform of analog poles scaled to the prewarped cutoff
+static std::vector<Complex> bilinear_poles (const std::vector<Complex>& analog, double cutoff, bool highPass) {
+	const double wc = 2.*std::tan(PI*cutoff);
+	std::vector<Complex> res;
+	for (auto& a: analog) {
+		Complex s = highPass ? wc/a : a*wc;
+		res.push_back((2. + s)/(2. - s));
+	}
+	return res;
+}
+
+static void normalize_gain (std::vector<BiquadCascade::Section>& sections, Complex z) {
+	double g = 1./std::abs(BiquadCascade::response(sections, z));
+	sections[0].b0 *= g;
+	sections[0].b1 *= g;
+	sections[0].b2 *= g;
+}
+
+Complex BiquadCascade::response(const std::vector<Section>& sections, Complex z) {
+	Complex zi = 1./z, h = 1.;
+	for (auto& a: sections) h *= (a.b0 + zi*(a.b1 + zi*a.b2))/(1. + zi*(a.a1 + zi*a.a2));
+	return h;
+}
+
+std::vector<BiquadCascade::Section> BiquadCascade::design_cr_rc(quint32 order, double tau) {
+	// One CR and 'order' RC stages with the same time constant, each with
+	// unity gain in its pass band.
+	const double p = std::exp(-1./tau);
+	std::vector<Section> res;
+	std::vector<double> zeros (1, 1.);
+	std::vector<Complex> poles (order + 1, p);
+	res = zpk_to_sections(zeros, poles);
+	res[0].b0 *= (1. + p)/2.;
+	res[0].b1 *= (1. + p)/2.;
+	res[0].b2 *= (1. + p)/2.;
+	for (quint32 i = 0; i < order; i++) {
+		Section& a = res[(i + 1)/2];
+		a.b0 *= 1. - p;
+		a.b1 *= 1. - p;
+		a.b2 *= 1. - p;
+	}
+	return res;
+}
+
+std::vector<BiquadCascade::Section> BiquadCascade::design_butterworth(quint32 order, double cutoff, bool highPass) {
+	std::vector<Complex> analog;
+	for (quint32 k = 0; k < order; k++) analog.push_back(std::polar(1., PI*(2.*k + order + 1.)/(2.*order)));
+	std::vector<double> zeros (order, highPass ? 1. : -1.);
+	std::vector<Section> res = zpk_to_sections(zeros, bilinear_poles(analog, cutoff, highPass));
+	normalize_gain(res, highPass ? -1. : 1.);
+	return res;
+}
+
+std::vector<BiquadCascade::Section> BiquadCascade::design_bessel(quint32 order, double cutoff) {
+	// Roots of the reverse Bessel polynomial by Durand-Kerner iterations
+	std::vector<double> coef (order + 1);
+	for (quint32 k = 0; k <= order; k++)
+		coef[k] = std::exp(std::lgamma(2.*order - k + 1.) - std::lgamma(k + 1.) - std::lgamma(order - k + 1.)) / std::pow(2., order - k);
+	auto poly = [&] (Complex s) { Complex r = 0.; for (qint32 k = order; k >= 0; k--) r = r*s + coef[k]; return r; };
+	std::vector<Complex> analog (order);
+	for (quint32 k = 0; k < order; k++) analog[k] = std::pow(Complex (0.4, 0.9), (double)k);
+	for (quint32 it = 0; it < 500; it++) {
+		for (quint32 k = 0; k < order; k++) {
+			Complex d = 1.;
+			for (quint32 j = 0; j < order; j++) if (j != k) d *= analog[k] - analog[j];
+			analog[k] -= poly(analog[k])/d;
+		}
+	}
+	// Scale to -3 dB at unit frequency
+	double lo = 0., hi = 4.*order;
+	for (quint32 it = 0; it < 100; it++) {
+		double w = (lo + hi)/2.;
+		if (std::norm(coef[0]/poly(Complex (0., w))) > 0.5) lo = w;
+		else hi = w;
+	}
+	for (auto& a: analog) a /= lo;
+	std::vector<double> zeros (order, -1.);
+	std::vector<Section> res = zpk_to_sections(zeros, bilinear_poles(analog, cutoff, false));
+	normalize_gain(res, 1.);
+	return res;
+}
+
+void BiquadCascade::set_sections() {
+	switch (design) {
+		case CR_RC:
+			sections = design_cr_rc(order, tau);
+			break;
+		case ButterworthLP:
+			sections = design_butterworth(order, cutoff, false);
+			break;
+		case ButterworthHP:
+			sections = design_butterworth(order, cutoff, true);
+			break;
+		default:
+			sections = design_bessel(order, cutoff);
+	}
+	state.assign(2*sections.size(), 0.);
+}
+
+// Sections of a cascade are run as a wavefront: lane s of a step handles
+// sample t - s, so a group of sections goes over the buffer in one pass.
+// Arithmetic matches the scalar loop exactly. z1 update adds the feedback
+// term last to keep it off the longest dependency chain.
+
+static void biquad_scalar (const BiquadCascade::Section* sec, double* state, quint32 count, double* data, quint32 size) {
+	for (quint32 i = 0; i < size; i++) {
+		double x = data[i];
+		for (quint32 n = 0; n < count; n++) {
+			double* z = state + 2*n;
+			double y = sec[n].b0*x + z[0];
+			z[0] = (sec[n].b1*x + z[1]) - sec[n].a1*y;
+			z[1] = sec[n].b2*x - sec[n].a2*y;
+			x = y;
+		}
+		data[i] = x;
+	}
+}
+
+#ifdef SHAPER_X86_SIMD
+__attribute__((target("avx2")))
+static void biquad_avx2 (const BiquadCascade::Section* sec, double* state, quint32 count, double* data, quint32 size) {
+	for (quint32 g = 0; g < count; g += 4) {
+		// Missing lanes are identity sections
+		double c[5][4], z1[4], z2[4];
+		for (quint32 l = 0; l < 4; l++) {
+			bool used = g + l < count;
+			const BiquadCascade::Section& s = sec[used ? g + l : 0];
+			c[0][l] = used ? s.b0 : 1.;
+			c[1][l] = used ? s.b1 : 0.;
+			c[2][l] = used ? s.b2 : 0.;
+			c[3][l] = used ? s.a1 : 0.;
+			c[4][l] = used ? s.a2 : 0.;
+			z1[l] = used ? state[2*(g + l)] : 0.;
+			z2[l] = used ? state[2*(g + l) + 1] : 0.;
+		}
+		const __m256d b0 = _mm256_loadu_pd(c[0]), b1 = _mm256_loadu_pd(c[1]), b2 = _mm256_loadu_pd(c[2]);
+		const __m256d a1 = _mm256_loadu_pd(c[3]), a2 = _mm256_loadu_pd(c[4]);
+		const __m256d lane = _mm256_set_pd(3., 2., 1., 0.);
+		__m256d vz1 = _mm256_loadu_pd(z1), vz2 = _mm256_loadu_pd(z2), y = _mm256_setzero_pd();
+		const qint64 steps = (qint64)size + 3;
+		for (qint64 t = 0; t < steps; t++) {
+			__m256d x = _mm256_permute4x64_pd(y, _MM_SHUFFLE(2, 1, 0, 0));
+			x = _mm256_blend_pd(x, _mm256_set1_pd(t < size ? data[t] : 0.), 0x1);
+			y = _mm256_add_pd(_mm256_mul_pd(b0, x), vz1);
+			__m256d nz1 = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(b1, x), vz2), _mm256_mul_pd(a1, y));
+			__m256d nz2 = _mm256_sub_pd(_mm256_mul_pd(b2, x), _mm256_mul_pd(a2, y));
+			if (t >= 3 && t < size) {
+				vz1 = nz1;
+				vz2 = nz2;
+			}
+			else {
+				// Pipeline fill and drain: lanes outside the buffer keep their state
+				__m256d pos = _mm256_sub_pd(_mm256_set1_pd((double)t), lane);
+				__m256d active = _mm256_and_pd(_mm256_cmp_pd(pos, _mm256_setzero_pd(), _CMP_GE_OQ),
+											   _mm256_cmp_pd(pos, _mm256_set1_pd((double)size), _CMP_LT_OQ));
+				vz1 = _mm256_blendv_pd(vz1, nz1, active);
+				vz2 = _mm256_blendv_pd(vz2, nz2, active);
+			}
+			if (t >= 3) data[t - 3] = _mm256_cvtsd_f64(_mm256_permute4x64_pd(y, _MM_SHUFFLE(3, 3, 3, 3)));
+		}
+		_mm256_storeu_pd(z1, vz1);
+		_mm256_storeu_pd(z2, vz2);
+		for (quint32 l = 0; l < 4 && g + l < count; l++) {
+			state[2*(g + l)] = z1[l];
+			state[2*(g + l) + 1] = z2[l];
+		}
+	}
+}
+#endif
+
+typedef void (*BiquadFunc) (const BiquadCascade::Section*, double*, quint32, double*, quint32);
+
+static BiquadFunc select_biquad () {
+#ifdef SHAPER_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return &biquad_avx2;
+#endif
+	return &biquad_scalar;
+}
+
+static const BiquadFunc biquad = select_biquad();
+
+void BiquadCascade::process() {
+	const quint32 size = output.size();
+	work.resize(size);
+	for (quint32 i = 0; i < size; i++) work[i] = (*inputPtr)[i];
+	biquad(sections.data(), state.data(), sections.size(), work.data(), size);
+	for (quint32 i = 0; i < size; i++) output[i] = work[i];
+}
+
+void BiquadCascade::set(std::shared_ptr<FilterSettings> settings) {
+	design = ((Settings*)settings.get())->design;
+	order = ((Settings*)settings.get())->order;
+	tau = ((Settings*)settings.get())->tau;
+	cutoff = ((Settings*)settings.get())->cutoff;
+	set_sections();
+}
+
+std::shared_ptr<Filter::FilterSettings> BiquadCascade::get() {
+	std::shared_ptr<FilterSettings> t (new Settings);
+	((Settings*)t.get())->design = design;
+	((Settings*)t.get())->order = order;
+	((Settings*)t.get())->tau = tau;
+	((Settings*)t.get())->cutoff = cutoff;
+	return t;
+}
+
+quint32 BiquadCascade::get_filter_id () const {
+	return FilteringProcessor::Biquad;
+}
+
+void BiquadCascade::save_settings(std::ostream &os) const {
+	os.write((char*)&design, 4);
+	os.write((char*)&order, 4);
+	os.write((char*)&tau, 4);
+	os.write((char*)&cutoff, 4);
+}
+
+void BiquadCascade::load_settings(std::istream &is) {
+	is.read((char*)&design, 4);
+	if (is.fail() || design >= TotalDesigns) throw std::runtime_error ("");
+	is.read((char*)&order, 4);
+	if (is.fail() || order == 0) throw std::runtime_error ("");
+	is.read((char*)&tau, 4);
+	if (is.fail()) throw std::runtime_error ("");
+	is.read((char*)&cutoff, 4);
+	if (is.fail()) throw std::runtime_error ("");
+	set_sections();
+}
+
+BiquadCascade::Settings & BiquadCascade::Settings::operator= (const FilterSettings& a) {
+	design = ((BiquadCascade::Settings*)(&a))->design;
+	order = ((BiquadCascade::Settings*)(&a))->order;
+	tau = ((BiquadCascade::Settings*)(&a))->tau;
+	cutoff = ((BiquadCascade::Settings*)(&a))->cutoff;
+	return *this;
+}
+
+void PoleZeroFilter::set_coefs() {
+	zero = std::exp(-1./decay);
+	pole = std::exp(-1./tau);
+}
+
+void PoleZeroFilter::process() {
+	const float* in = inputPtr->data();
+	for (quint32 i = 0, ie = output.size(); i < ie; i++) {
+		lastOut = pole*lastOut + in[i] - zero*lastIn;
+		lastIn = in[i];
+		output[i] = lastOut;
+	}
+}
+
+void PoleZeroFilter::set(std::shared_ptr<FilterSettings> settings) {
+	decay = ((Settings*)settings.get())->decay;
+	tau = ((Settings*)settings.get())->tau;
+	set_coefs();
+}
+
+std::shared_ptr<Filter::FilterSettings> PoleZeroFilter::get() {
+	std::shared_ptr<FilterSettings> t (new Settings);
+	((Settings*)t.get())->decay = decay;
+	((Settings*)t.get())->tau = tau;
+	return t;
+}
+
+quint32 PoleZeroFilter::get_filter_id () const {
+	return FilteringProcessor::PoleZero;
+}
+
+void PoleZeroFilter::save_settings(std::ostream &os) const {
+	os.write((char*)&decay, 4);
+	os.write((char*)&tau, 4);
+}
+
+void PoleZeroFilter::load_settings(std::istream &is) {
+	is.read((char*)&decay, 4);
+	if (is.fail()) throw std::runtime_error ("");
+	is.read((char*)&tau, 4);
+	if (is.fail()) throw std::runtime_error ("");
+	set_coefs();
+}
+
+PoleZeroFilter::Settings & PoleZeroFilter::Settings::operator= (const FilterSettings& a) {
+	decay = ((PoleZeroFilter::Settings*)(&a))->decay;
+	tau = ((PoleZeroFilter::Settings*)(&a))->tau;
+	return *this;
+}
+
+void BaselineRestorer::process() {
+	const float* in = inputPtr->data();
+	const double rate = 1./window;
+	// Gate closed much longer than a pulse means the baseline has jumped
+	const quint32 stuckLimit = holdoff + 4*window;
+	for (quint32 i = 0, ie = output.size(); i < ie; i++) {
+		double dev = in[i] - baseline;
+		if (std::fabs(dev) > threshold) gateCounter = holdoff;
+		if (gateCounter) {
+			gateCounter--;
+			if (++gatedSamples > stuckLimit) {
+				baseline = in[i];
+				gateCounter = 0;
+				gatedSamples = 0;
+			}
+		}
+		else {
+			baseline += dev*rate;
+			gatedSamples = 0;
+		}
+		output[i] = in[i] - baseline;
+	}
+}
+
+void BaselineRestorer::set(std::shared_ptr<FilterSettings> settings) {
+	threshold = ((Settings*)settings.get())->threshold;
+	window = ((Settings*)settings.get())->window;
+	holdoff = ((Settings*)settings.get())->holdoff;
+}
+
+std::shared_ptr<Filter::FilterSettings> BaselineRestorer::get() {
+	std::shared_ptr<FilterSettings> t (new Settings);
+	((Settings*)t.get())->threshold = threshold;
+	((Settings*)t.get())->window = window;
+	((Settings*)t.get())->holdoff = holdoff;
+	return t;
+}
+
+quint32 BaselineRestorer::get_filter_id () const {
+	return FilteringProcessor::BaselineRestorer;
+}
+
+void BaselineRestorer::save_settings(std::ostream &os) const {
+	os.write((char*)&threshold, 4);
+	os.write((char*)&window, 4);
+	os.write((char*)&holdoff, 4);
+}
+
+void BaselineRestorer::load_settings(std::istream &is) {
+	is.read((char*)&threshold, 4);
+	if (is.fail()) throw std::runtime_error ("");
+	is.read((char*)&window, 4);
+	if (is.fail() || window == 0) throw std::runtime_error ("");
+	is.read((char*)&holdoff, 4);
+	if (is.fail()) throw std::runtime_error ("");
+}
+
+BaselineRestorer::Settings & BaselineRestorer::Settings::operator= (const FilterSettings& a) {
+	threshold = ((BaselineRestorer::Settings*)(&a))->threshold;
+	window = ((BaselineRestorer::Settings*)(&a))->window;
+	holdoff = ((BaselineRestorer::Settings*)(&a))->holdoff;
+	return *this;
+}
+
+std::vector<float> DecimationFilter::design_kernel(quint32 ratio, quint32 tapsPerPhase, float bandwidth) {
+	const quint32 len = ratio*tapsPerPhase;
+	const double fc = bandwidth*0.5/ratio, center = (len - 1)*0.5;
+	std::vector<double> h (len);
+	double sum = 0.;
+	for (quint32 k = 0; k < len; k++) {
+		double x = 2.*fc*(k - center);
+		double sinc = std::fabs(x) < 1e-12 ? 1. : std::sin(PI*x)/(PI*x);
+		double w = len > 1 ? 0.42 - 0.5*std::cos(2.*PI*k/(len - 1)) + 0.08*std::cos(4.*PI*k/(len - 1)) : 1.;
+		h[k] = 2.*fc*sinc*w;
+		sum += h[k];
+	}
+	std::vector<float> kernel (len);
+	for (quint32 k = 0; k < len; k++) kernel[k] = h[k]/sum;
+	return kernel;
+}
+
+void DecimationFilter::set_phases() {
+	// y[m] = sum h[k]*x[m*ratio + ratio-1 - k]. With k = j*ratio + ratio-1 - p
+	// phase p filters x[m*ratio + p] with taps h[j*ratio + ratio-1 - p],
+	// stored reversed for convolve()
+	std::vector<float> kernel = design_kernel(ratio, tapsPerPhase, bandwidth);
+	phases.assign(ratio, std::vector<float> (tapsPerPhase));
+	for (quint32 p = 0; p < ratio; p++)
+		for (quint32 n = 0; n < tapsPerPhase; n++)
+			phases[p][n] = kernel[(tapsPerPhase - 1 - n)*ratio + ratio - 1 - p];
+	buffer.assign(ratio*(tapsPerPhase - 1), 0.f);
+}
+
+void DecimationFilter::process() {
+	const quint32 size = output.size(), hist = tapsPerPhase - 1;
+	const float* in = inputPtr->data();
+	staging.resize(hist + size);
+	phaseOut.resize(size);
+	std::fill(output.begin(), output.end(), 0.f);
+	for (quint32 p = 0; p < ratio; p++) {
+		float* phaseHist = buffer.data() + p*hist;
+		std::copy(phaseHist, phaseHist + hist, staging.begin());
+		for (quint32 m = 0; m < size; m++) staging[hist + m] = in[m*ratio + p];
+		convolve(staging.data(), phases[p].data(), tapsPerPhase, phaseOut.data(), size);
+		for (quint32 m = 0; m < size; m++) output[m] += phaseOut[m];
+		std::copy(staging.end() - hist, staging.end(), phaseHist);
+	}
+}
+
+void DecimationFilter::set(std::shared_ptr<FilterSettings> settings) {
+	ratio = ((Settings*)settings.get())->ratio;
+	tapsPerPhase = ((Settings*)settings.get())->tapsPerPhase;
+	bandwidth = ((Settings*)settings.get())->bandwidth;
+	set_phases();
+}
+
+std::shared_ptr<Filter::FilterSettings> DecimationFilter::get() {
+	std::shared_ptr<FilterSettings> t (new Settings);
+	((Settings*)t.get())->ratio = ratio;
+	((Settings*)t.get())->tapsPerPhase = tapsPerPhase;
+	((Settings*)t.get())->bandwidth = bandwidth;
+	return t;
+}
+
+quint32 DecimationFilter::get_filter_id () const {
+	return FilteringProcessor::Decimator;
+}
+
+void DecimationFilter::save_settings(std::ostream &os) const {
+	os.write((char*)&ratio, 4);
+	os.write((char*)&tapsPerPhase, 4);
+	os.write((char*)&bandwidth, 4);
+}
+
+void DecimationFilter::load_settings(std::istream &is) {
+	is.read((char*)&ratio, 4);
+	if (is.fail() || ratio == 0) throw std::runtime_error ("");
+	is.read((char*)&tapsPerPhase, 4);
+	if (is.fail() || tapsPerPhase == 0) throw std::runtime_error ("");
+	is.read((char*)&bandwidth, 4);
+	if (is.fail()) throw std::runtime_error ("");
+	set_phases();
+}
+
+DecimationFilter::Settings & DecimationFilter::Settings::operator= (const FilterSettings& a) {
+	ratio = ((DecimationFilter::Settings*)(&a))->ratio;
+	tapsPerPhase = ((DecimationFilter::Settings*)(&a))->tapsPerPhase;
+	bandwidth = ((DecimationFilter::Settings*)(&a))->bandwidth;
+	return *this;
+}
+
+std::vector<float> MatchedFilter::design_kernel(const std::vector<float>& pulse, const std::vector<float>& noisePSD,
+												quint32 kernelSize, quint32 mode, float amplitude) {
+	// Template sits in the middle of the block so the whitened kernel spreads
+	// to both sides without wrapping around
+	const quint32 len = std::min<quint32> (pulse.size(), kernelSize/2), offset = (kernelSize - len)/2;
+	std::vector<float> tmpl (kernelSize, 0.f);
+	float peak = 0.f;
+	for (quint32 i = 0; i < len; i++) {
+		tmpl[offset + i] = pulse[i] - pulse[0];
+		peak = std::max(peak, std::fabs(tmpl[offset + i]));
+	}
+	if (peak == 0.f) {
+		std::vector<float> kernel (kernelSize, 0.f);
+		kernel.back() = 1.f;
+		return kernel;
+	}
+	for (auto& a: tmpl) a /= peak;
+	FFT<float> fft (kernelSize);
+	fft.set_time_data(tmpl);
+	fft.go(false);
+	std::vector<std::complex<float>> spec = fft.get_freq_data();
+	const bool white = noisePSD.size() != kernelSize/2;
+	const float power = amplitude*amplitude;
+	for (quint32 i = 0; i < kernelSize; i++) {
+		quint32 bin = std::min(std::min(i, kernelSize - i), kernelSize/2 - 1);
+		float noise = white ? 1.f : std::max(noisePSD[bin], 1e-20f);
+		if (mode == WienerMode) spec[i] /= power*std::norm(spec[i]) + noise;
+		else spec[i] /= noise;
+	}
+	fft.set_freq_data(spec);
+	fft.go(true);
+	std::vector<float> kernel (kernelSize);
+	const quint32 taper = kernelSize/8;
+	double resp = 0.;
+	for (quint32 i = 0; i < kernelSize; i++) {
+		kernel[i] = fft.get_time_data()[i].real();
+		quint32 edge = std::min(i, kernelSize - 1 - i);
+		if (edge < taper) kernel[i] *= 0.5f - 0.5f*std::cos(PI*edge/taper);
+		resp += (double)kernel[i]*tmpl[i];
+	}
+	for (auto& a: kernel) a /= resp;
+	return kernel;
+}
+
+void MatchedFilter::set_shape() {
+	shape = design_kernel(pulse, noisePSD, kernelSize, mode, amplitude);
+	buffer.resize(kernelSize, 0.f);
+	shape_changed();
+}
+
+// Noise is measured on the raw input, segments with a sample further than
+// psdGate sigmas from the median hold a pulse and would turn the kernel
+// into a deconvolution. Sigma comes from the median absolute deviation,
+// so the pulse itself does not raise the gate. It is at least the smallest
+// nonzero deviation, one step of a quantised or idle input.
+static const float psdGate = 5.f;
+
+bool MatchedFilter::has_pulse() {
+	gate.assign(segment.begin(), segment.end());
+	std::nth_element(gate.begin(), gate.begin() + gate.size()/2, gate.end());
+	const float median = gate[gate.size()/2];
+	float step = std::numeric_limits<float>::max();
+	for (auto& a: gate) {
+		a = std::abs(a - median);
+		if (a > 0.f) step = std::min(step, a);
+	}
+	std::nth_element(gate.begin(), gate.begin() + gate.size()/2, gate.end());
+	const float limit = psdGate*std::max(1.4826f*gate[gate.size()/2], step);
+	for (auto a: segment) if (std::abs(a - median) > limit) return true;
+	return false;
+}
+
+// Ends the measurement, without any accepted segment the old spectrum stays
+void MatchedFilter::finish_psd() {
+	measureNoise = false;
+	measureFailed = psdSegments == 0;
+	if (psdSegments) {
+		noisePSD.resize(kernelSize/2);
+		for (quint32 k = 0; k < kernelSize/2; k++) noisePSD[k] = psdSum[k]/psdSegments;
+	}
+	set_shape();
+}
+
+void MatchedFilter::accumulate_psd() {
+	const float* in = inputPtr->data();
+	if (fft.data_size() != kernelSize) fft.set_size(kernelSize);
+	psdSum.resize(kernelSize/2, 0.);
+	for (quint32 i = 0, ie = output.size(); i < ie;) {
+		quint32 n = std::min<quint32> (kernelSize - segment.size(), ie - i);
+		segment.insert(segment.end(), in + i, in + i + n);
+		i += n;
+		if (segment.size() < kernelSize) break;
+		if (has_pulse()) {
+			segment.clear();
+			if (++psdRejected == psdMaxRejected) {
+				finish_psd();
+				return;
+			}
+			continue;
+		}
+		double mean = 0., wSum = 0.;
+		for (auto a: segment) mean += a;
+		mean /= kernelSize;
+		for (quint32 k = 0; k < kernelSize; k++) {
+			float w = 0.5f - 0.5f*std::cos(2.f*PI*k/kernelSize);
+			segment[k] = (segment[k] - mean)*w;
+			wSum += w*w;
+		}
+		fft.set_time_data(segment);
+		fft.go(false);
+		// Scaled to the power of an unwindowed block
+		for (quint32 k = 0; k < kernelSize/2; k++) psdSum[k] += std::norm(fft.get_freq_data()[k])*kernelSize/wSum;
+		segment.clear();
+		if (++psdSegments == psdAverages) {
+			finish_psd();
+			return;
+		}
+	}
+}
+
+void MatchedFilter::process() {
+	if (measureNoise) accumulate_psd();
+	Shaper::process();
+}
+
+void MatchedFilter::set(std::shared_ptr<FilterSettings> settings) {
+	mode = ((Settings*)settings.get())->mode;
+	kernelSize = ((Settings*)settings.get())->kernelSize;
+	amplitude = ((Settings*)settings.get())->amplitude;
+	pulse = ((Settings*)settings.get())->pulse;
+	noisePSD = ((Settings*)settings.get())->noisePSD;
+	measureNoise = ((Settings*)settings.get())->measureNoise;
+	measureFailed = false;
+	segment.clear();
+	psdSum.clear();
+	psdSegments = 0;
+	psdRejected = 0;
+	set_shape();
+}
+
+std::shared_ptr<Filter::FilterSettings> MatchedFilter::get() {
+	std::shared_ptr<FilterSettings> t (new Settings);
+	((Settings*)t.get())->mode = mode;
+	((Settings*)t.get())->kernelSize = kernelSize;
+	((Settings*)t.get())->amplitude = amplitude;
+	((Settings*)t.get())->pulse = pulse;
+	((Settings*)t.get())->noisePSD = noisePSD;
+	((Settings*)t.get())->measureNoise = measureNoise;
+	((Settings*)t.get())->measureFailed = measureFailed;
+	return t;
+}
+
+quint32 MatchedFilter::get_filter_id () const {
+	return FilteringProcessor::Matched;
+}
+
+void MatchedFilter::save_settings(std::ostream &os) const {
+	quint32 sz;
+	os.write((char*)&mode, 4);
+	os.write((char*)&kernelSize, 4);
+	os.write((char*)&amplitude, 4);
+	os.write((char*)&(sz = pulse.size()), 4);
+	os.write((char*)pulse.data(), 4*pulse.size());
+	os.write((char*)&(sz = noisePSD.size()), 4);
+	os.write((char*)noisePSD.data(), 4*noisePSD.size());
+}
+
+void MatchedFilter::load_settings(std::istream &is) {
+	quint32 sz;
+	is.read((char*)&mode, 4);
+	if (is.fail() || mode >= TotalModes) throw std::runtime_error ("");
+	is.read((char*)&kernelSize, 4);
+	if (is.fail() || kernelSize < 16 || (kernelSize & (kernelSize - 1))) throw std::runtime_error ("");
+	is.read((char*)&amplitude, 4);
+	if (is.fail() || !(amplitude > 0.f)) throw std::runtime_error ("");
+	is.read((char*)&sz, 4);
+	if (is.fail() || sz > kernelSize) throw std::runtime_error ("");
+	pulse.resize(sz);
+	is.read((char*)pulse.data(), 4*sz);
+	if (is.fail()) throw std::runtime_error ("");
+	is.read((char*)&sz, 4);
+	if (is.fail() || sz > kernelSize) throw std::runtime_error ("");
+	noisePSD.resize(sz);
+	is.read((char*)noisePSD.data(), 4*sz);
+	if (is.fail()) throw std::runtime_error ("");
+	measureNoise = false;
+	measureFailed = false;
+	set_shape();
+}
+
+MatchedFilter::Settings & MatchedFilter::Settings::operator= (const FilterSettings& a) {
+	mode = ((MatchedFilter::Settings*)(&a))->mode;
+	kernelSize = ((MatchedFilter::Settings*)(&a))->kernelSize;
+	amplitude = ((MatchedFilter::Settings*)(&a))->amplitude;
+	pulse = ((MatchedFilter::Settings*)(&a))->pulse;
+	noisePSD = ((MatchedFilter::Settings*)(&a))->noisePSD;
+	measureNoise = ((MatchedFilter::Settings*)(&a))->measureNoise;
+	measureFailed = ((MatchedFilter::Settings*)(&a))->measureFailed;
+	return *this;
+}
+
 FilteringThread::FilteringThread (quint32 dataSize) : size(dataSize) {
 	setAutoDelete(false);
 }
@@ -412,20 +1339,74 @@ FilteringThread::FilteringThread (quint32 dataSize) : size(dataSize) {
 FilteringThread::~FilteringThread () {
 }
 
+void FilteringThread::process_filter(quint32 filter_num, std::vector<float> const* data) {
+	quint32 outSize = data->size()/filters[filter_num]->get_decimation();
+	if (filters[filter_num]->get_size() != outSize) filters[filter_num]->set_size(outSize);
+	filters[filter_num]->set_data(data);
+	filters[filter_num]->process();
+}
+
 void FilteringThread::run () {
 	if (filters.empty() || !isEnabled) return;
-	filters[0]->set_data(inputPtr);
-	filters[0]->process();
-	for (quint32 i = 1, ie = filters.size(); i < ie; i++) {
-		filters[i]->set_data(filters[i-1]->get_data());
-		filters[i]->process();
+	// Sizes are taken from the data reaching each filter, they shrink after a decimator
+	std::vector<float> const* data = inputPtr;
+	for (quint32 i = 0, ie = filters.size(); i < ie;) {
+		const quint32 len = data->size();
+		quint32 blocks = (len + fusedBlockSize - 1)/fusedBlockSize;
+		quint32 blockSize = 0;
+		quint32 j = i;
+		if (isFused && blocks >= fusedMinBlocks) {
+			// Equal blocks, the last one is at most 'blocks' samples shorter
+			blockSize = (len + blocks - 1)/blocks;
+			quint32 minBlock = len - (blocks - 1)*blockSize;
+			while (j < ie && filters[j]->is_streamable(minBlock)) j++;
+		}
+		if (j - i < 2) {
+			process_filter(i, data);
+			data = filters[i++]->get_data();
+			continue;
+		}
+		fusedOutput.resize(len);
+		for (quint32 beg = 0; beg < len; beg += blockSize) {
+			quint32 bLen = std::min(blockSize, len - beg);
+			blockInput.assign(data->begin() + beg, data->begin() + beg + bLen);
+			std::vector<float> const* blockData = &blockInput;
+			for (quint32 k = i; k < j; k++) {
+				if (filters[k]->get_size() != bLen) filters[k]->set_size(bLen);
+				filters[k]->set_data(blockData);
+				filters[k]->process();
+				blockData = filters[k]->get_data();
+			}
+			std::copy(blockData->begin(), blockData->end(), fusedOutput.begin() + beg);
+		}
+		data = &fusedOutput;
+		i = j;
 	}
+	outputPtr = data;
 }
 
 void FilteringThread::set_size(quint32 _size) {
 	size = _size;
 	for (auto& a: filters)
 		a->set_size(size);
+	fit_decimation();
+}
+
+// Each decimator has to divide the data reaching it, otherwise the tail of
+// every buffer is lost. Ratios are lowered to the nearest divisor.
+void FilteringThread::fit_decimation() {
+	quint32 left = size;
+	for (auto& a: filters) {
+		if (a->get_filter_id() != FilteringProcessor::Decimator) continue;
+		quint32 ratio = a->get_decimation();
+		while (ratio > 1 && left % ratio) ratio--;
+		if (ratio != a->get_decimation()) {
+			std::shared_ptr<Filter::FilterSettings> t = a->get();
+			((DecimationFilter::Settings*)t.get())->ratio = ratio;
+			a->set(t);
+		}
+		left /= ratio;
+	}
 }
 
 void FilteringThread::set_input(std::vector<float> const* input) {
@@ -433,10 +1414,18 @@ void FilteringThread::set_input(std::vector<float> const* input) {
 }
 
 std::vector<float> const* FilteringThread::get_output() const {
-	if (filters.size() && isEnabled) return filters[filters.size()-1]->get_data();
+	// Set by the last run, fusedOutput when the last filter ran block by block
+	if (filters.size() && isEnabled)
+		return outputPtr ? outputPtr : filters.back()->get_data();
 	else return inputPtr;
 }
 
+quint32 FilteringThread::get_decimation() const {
+	quint32 dec = 1;
+	for (auto& a: filters) dec *= a->get_decimation();
+	return dec;
+}
+
 void FilteringThread::add_filter(quint32 filter_id) {
 	switch (filter_id) {
 		case FilteringProcessor::Delay:
@@ -469,14 +1458,32 @@ void FilteringThread::add_filter(quint32 filter_id) {
 		case FilteringProcessor::Cusp:
 			filters.push_back(std::shared_ptr<Filter>(new CuspShaper (size)));
 			break;
+		case FilteringProcessor::Biquad:
+			filters.push_back(std::shared_ptr<Filter>(new BiquadCascade (size)));
+			break;
+		case FilteringProcessor::PoleZero:
+			filters.push_back(std::shared_ptr<Filter>(new PoleZeroFilter (size)));
+			break;
+		case FilteringProcessor::BaselineRestorer:
+			filters.push_back(std::shared_ptr<Filter>(new BaselineRestorer (size)));
+			break;
+		case FilteringProcessor::Decimator:
+			filters.push_back(std::shared_ptr<Filter>(new DecimationFilter (size)));
+			break;
+		case FilteringProcessor::Matched:
+			filters.push_back(std::shared_ptr<Filter>(new MatchedFilter (size)));
+			break;
 		default:
 			assert(false);
 	}
+	outputPtr = 0x0;
+	fit_decimation();
 }
 
 void FilteringThread::del_filter(quint32 filter_num) {
 	assert (filter_num < filters.size());
 	filters.erase(filters.begin() + filter_num);
+	outputPtr = 0x0;
 }
 
 quint32 FilteringThread::get_filter_count() const {
@@ -516,9 +1523,26 @@ void FilteringThread::set_filter_id(quint32 filter_id, quint32 filter_num) {
 		case FilteringProcessor::Cusp:
 			filters[filter_num] = std::shared_ptr<Filter>(new CuspShaper (size));
 			break;
+		case FilteringProcessor::Biquad:
+			filters[filter_num] = std::shared_ptr<Filter>(new BiquadCascade (size));
+			break;
+		case FilteringProcessor::PoleZero:
+			filters[filter_num] = std::shared_ptr<Filter>(new PoleZeroFilter (size));
+			break;
+		case FilteringProcessor::BaselineRestorer:
+			filters[filter_num] = std::shared_ptr<Filter>(new BaselineRestorer (size));
+			break;
+		case FilteringProcessor::Decimator:
+			filters[filter_num] = std::shared_ptr<Filter>(new DecimationFilter (size));
+			break;
+		case FilteringProcessor::Matched:
+			filters[filter_num] = std::shared_ptr<Filter>(new MatchedFilter (size));
+			break;
 		default:
 			assert(false);
 	}
+	outputPtr = 0x0;
+	fit_decimation();
 }
 
 quint32 FilteringThread::get_filter_id(quint32 filter_num) const {
@@ -547,6 +1571,7 @@ void FilteringThread::load_settings(std::istream &is) {
 	is.read((char*)&sz, 4);
 	if (is.fail()) throw std::runtime_error ("");
 	filters.resize(0);
+	outputPtr = 0x0;
 	for (quint32 i = 0, ie = sz; i < ie; i++) {
 		is.read((char*)&sz, 4);
 		if (is.fail()) throw std::runtime_error ("");
@@ -581,11 +1606,281 @@ void FilteringThread::load_settings(std::istream &is) {
 			case FilteringProcessor::Cusp:
 				filters.push_back(std::shared_ptr<Filter>(new CuspShaper (size)));
 				break;
+			case FilteringProcessor::Biquad:
+				filters.push_back(std::shared_ptr<Filter>(new BiquadCascade (size)));
+				break;
+			case FilteringProcessor::PoleZero:
+				filters.push_back(std::shared_ptr<Filter>(new PoleZeroFilter (size)));
+				break;
+			case FilteringProcessor::BaselineRestorer:
+				filters.push_back(std::shared_ptr<Filter>(new BaselineRestorer (size)));
+				break;
+			case FilteringProcessor::Decimator:
+				filters.push_back(std::shared_ptr<Filter>(new DecimationFilter (size)));
+				break;
+			case FilteringProcessor::Matched:
+				filters.push_back(std::shared_ptr<Filter>(new MatchedFilter (size)));
+				break;
 			default:
 				assert (false);
 		}
 		filters[i]->load_settings(is);
 	}
+	fit_decimation();
+}
+
+bool FilteringThread::is_lane_chain() const {
+	if (filters.empty() || !isEnabled) return false;
+	for (auto& a: filters)
+		if (!IIRLanes::is_lane_filter(a->get_filter_id())) return false;
+	return true;
+}
+
+bool FilteringThread::same_chain(FilteringThread const* a) const {
+	if (filters.size() != a->filters.size()) return false;
+	for (quint32 i = 0, ie = filters.size(); i < ie; i++)
+		if (filters[i]->get_filter_id() != a->filters[i]->get_filter_id()) return false;
+	return true;
+}
+
+// Lane kernels work in place on IIRLanes::maxLanes interleaved streams and
+// repeat the arithmetic of the per-stream filters exactly.
+
+typedef void (*LaneFunc) (float*, quint32, const float*, float*, float*);
+
+static void rc_lanes (float* data, quint32 size, const float* alpha, float* lastIn, float* lastOut) {
+	(void)lastIn;
+	for (quint32 i = 0; i < size; i++) {
+		float* x = data + i*IIRLanes::maxLanes;
+		for (quint32 l = 0; l < IIRLanes::maxLanes; l++) {
+			lastOut[l] = alpha[l]*x[l] + (1.f - alpha[l])*lastOut[l];
+			x[l] = lastOut[l];
+		}
+	}
+}
+
+static void cr_lanes (float* data, quint32 size, const float* alpha, float* lastIn, float* lastOut) {
+	for (quint32 i = 0; i < size; i++) {
+		float* x = data + i*IIRLanes::maxLanes;
+		for (quint32 l = 0; l < IIRLanes::maxLanes; l++) {
+			lastOut[l] = alpha[l]*(x[l] - lastIn[l] + lastOut[l]);
+			lastIn[l] = x[l];
+			x[l] = lastOut[l];
+		}
+	}
+}
+
+static void cr_rev_lanes (float* data, quint32 size, const float* alpha, float* lastIn, float* lastOut) {
+	for (quint32 i = 0; i < size; i++) {
+		float* x = data + i*IIRLanes::maxLanes;
+		for (quint32 l = 0; l < IIRLanes::maxLanes; l++) {
+			float y = x[l]/alpha[l] - lastIn[l] + lastOut[l]*0.9999;
+			lastIn[l] = x[l];
+			x[l] = lastOut[l] = y;
+		}
+	}
+}
+
+#ifdef SHAPER_X86_SIMD
+// Plain AVX without FMA, so products and sums round as in the scalar code
+__attribute__((target("avx")))
+static void rc_lanes_avx (float* data, quint32 size, const float* alpha, float* lastIn, float* lastOut) {
+	(void)lastIn;
+	const __m256 a = _mm256_loadu_ps(alpha);
+	const __m256 b = _mm256_sub_ps(_mm256_set1_ps(1.f), a);
+	__m256 y = _mm256_loadu_ps(lastOut);
+	for (quint32 i = 0; i < size; i++) {
+		float* x = data + i*IIRLanes::maxLanes;
+		y = _mm256_add_ps(_mm256_mul_ps(a, _mm256_loadu_ps(x)), _mm256_mul_ps(b, y));
+		_mm256_storeu_ps(x, y);
+	}
+	_mm256_storeu_ps(lastOut, y);
+}
+
+__attribute__((target("avx")))
+static void cr_lanes_avx (float* data, quint32 size, const float* alpha, float* lastIn, float* lastOut) {
+	const __m256 a = _mm256_loadu_ps(alpha);
+	__m256 xp = _mm256_loadu_ps(lastIn);
+	__m256 y = _mm256_loadu_ps(lastOut);
+	for (quint32 i = 0; i < size; i++) {
+		float* x = data + i*IIRLanes::maxLanes;
+		__m256 xi = _mm256_loadu_ps(x);
+		y = _mm256_mul_ps(a, _mm256_add_ps(_mm256_sub_ps(xi, xp), y));
+		xp = xi;
+		_mm256_storeu_ps(x, y);
+	}
+	_mm256_storeu_ps(lastIn, xp);
+	_mm256_storeu_ps(lastOut, y);
+}
+
+__attribute__((target("avx")))
+static void cr_rev_lanes_avx (float* data, quint32 size, const float* alpha, float* lastIn, float* lastOut) {
+	const __m256 a = _mm256_loadu_ps(alpha);
+	const __m256d decay = _mm256_set1_pd(0.9999);
+	__m256 xp = _mm256_loadu_ps(lastIn);
+	__m256 y = _mm256_loadu_ps(lastOut);
+	for (quint32 i = 0; i < size; i++) {
+		float* x = data + i*IIRLanes::maxLanes;
+		__m256 xi = _mm256_loadu_ps(x);
+		__m256 f = _mm256_sub_ps(_mm256_div_ps(xi, a), xp);
+		// Feedback term is evaluated in double as in CR_REV_IIR_Filter
+		__m256d lo = _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(f)),
+								   _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(y)), decay));
+		__m256d hi = _mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)),
+								   _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(y, 1)), decay));
+		y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+		xp = xi;
+		_mm256_storeu_ps(x, y);
+	}
+	_mm256_storeu_ps(lastIn, xp);
+	_mm256_storeu_ps(lastOut, y);
+}
+#endif
+
+struct LaneKernels {
+	LaneFunc rc, cr, cr_rev;
+};
+
+static LaneKernels select_lane_kernels () {
+	LaneKernels k = {&rc_lanes, &cr_lanes, &cr_rev_lanes};
+#ifdef SHAPER_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx")) {
+		k.rc = &rc_lanes_avx;
+		k.cr = &cr_lanes_avx;
+		k.cr_rev = &cr_rev_lanes_avx;
+	}
+#endif
+	return k;
+}
+
+static const LaneKernels laneKernels = select_lane_kernels();
+
+// Solves y[i] += c*y[i-1] in place, starting from y0. The buffer is cut into
+// maxLanes chunks whose recursions run interleaved from zero state, then each
+// chunk gets the decayed last value of the previous one added. Feedback,
+// carries and powers are of type T, double for CR_REV as in its filter.
+template <typename T>
+static void first_order_chunks (float* y, quint32 size, T c, float y0, std::vector<T>& powers) {
+	const quint32 lanes = IIRLanes::maxLanes;
+	const quint32 chunk = size/lanes;
+	quint32 i = 0;
+	if (chunk >= 64) {
+		T carry[lanes] = {y0};
+		for (quint32 j = 0; j < chunk; j++) {
+#pragma GCC unroll 8
+			for (quint32 l = 0; l < lanes; l++) {
+				float& v = y[l*chunk + j];
+				v += c*carry[l];
+				carry[l] = v;
+			}
+		}
+		// Powers stop before they turn denormal, the carry has decayed by then
+		powers.resize(chunk);
+		quint32 reach = 0;
+		for (T p = std::fabs(c); reach < chunk && p > T(1.e-30); reach++, p *= std::fabs(c)) powers[reach] = reach ? powers[reach-1]*c : c;
+		for (quint32 l = 1; l < lanes; l++) {
+			const T prev = y[l*chunk - 1];
+			float* yc = y + l*chunk;
+			for (quint32 j = 0; j < reach; j++) yc[j] += powers[j]*prev;
+		}
+		i = lanes*chunk;
+		y0 = y[i - 1];
+	}
+	for (; i < size; i++) {
+		y[i] += c*y0;
+		y0 = y[i];
+	}
+}
+
+bool IIRLanes::is_lane_filter(quint32 filter_id) {
+	return filter_id == FilteringProcessor::RC_IIR ||
+		   filter_id == FilteringProcessor::CR_IIR ||
+		   filter_id == FilteringProcessor::CR_REV_IIR;
+}
+
+void IIRLanes::process_single(FilteringThread* stream) {
+	const quint32 size = stream->get_size();
+	const float* in = stream->get_input()->data();
+	for (auto& a: stream->get_filters()) {
+		R_C_Filter* filter = static_cast<R_C_Filter*> (a.get());
+		if (filter->get_size() != size) filter->set_size(size);
+		float* out = filter->output_data().data();
+		std::vector<float>& state = filter->get_state();
+		const float alpha = filter->get_alpha();
+		// Each filter is y[i] = u[i] + c*y[i-1] with u depending on the input only
+		switch (filter->get_filter_id()) {
+			case FilteringProcessor::RC_IIR:
+				for (quint32 i = 0; i < size; i++) out[i] = alpha*in[i];
+				first_order_chunks(out, size, 1.f - alpha, state.back(), powers);
+				break;
+			case FilteringProcessor::CR_IIR:
+				out[0] = alpha*(in[0] - state[0]);
+				for (quint32 i = 1; i < size; i++) out[i] = alpha*(in[i] - in[i-1]);
+				first_order_chunks(out, size, alpha, state.back(), powers);
+				break;
+			default:
+				out[0] = in[0]/alpha - state[0];
+				for (quint32 i = 1; i < size; i++) out[i] = in[i]/alpha - in[i-1];
+				first_order_chunks(out, size, 0.9999, state.back(), powersDouble);
+		}
+		if (state.size() > 1) state[0] = in[size-1];
+		state.back() = out[size-1];
+		in = out;
+	}
+	stream->set_output(stream->get_filters().back()->get_data());
+}
+
+void IIRLanes::process(std::vector<FilteringThread*> const& streams) {
+	assert (streams.size() && streams.size() <= maxLanes);
+	if (streams.size() == 1) {
+		process_single(streams[0]);
+		return;
+	}
+	const quint32 size = streams[0]->get_size(), lanes = streams.size();
+	data.resize(size*maxLanes);
+	for (quint32 l = 0; l < maxLanes; l++) {
+		if (l < lanes) {
+			const float* in = streams[l]->get_input()->data();
+			for (quint32 i = 0; i < size; i++) data[i*maxLanes + l] = in[i];
+		}
+		else for (quint32 i = 0; i < size; i++) data[i*maxLanes + l] = 0.f;
+	}
+	for (quint32 n = 0, ne = streams[0]->get_filters().size(); n < ne; n++) {
+		float alpha[maxLanes], lastIn[maxLanes], lastOut[maxLanes];
+		std::fill(alpha, alpha + maxLanes, 1.f);
+		std::fill(lastIn, lastIn + maxLanes, 0.f);
+		std::fill(lastOut, lastOut + maxLanes, 0.f);
+		for (quint32 l = 0; l < lanes; l++) {
+			R_C_Filter* filter = static_cast<R_C_Filter*> (streams[l]->get_filters()[n].get());
+			std::vector<float>& state = filter->get_state();
+			alpha[l] = filter->get_alpha();
+			lastIn[l] = state[0];
+			lastOut[l] = state.back();
+		}
+		switch (streams[0]->get_filters()[n]->get_filter_id()) {
+			case FilteringProcessor::RC_IIR:
+				laneKernels.rc(data.data(), size, alpha, lastIn, lastOut);
+				break;
+			case FilteringProcessor::CR_IIR:
+				laneKernels.cr(data.data(), size, alpha, lastIn, lastOut);
+				break;
+			default:
+				laneKernels.cr_rev(data.data(), size, alpha, lastIn, lastOut);
+		}
+		for (quint32 l = 0; l < lanes; l++) {
+			std::vector<float>& state = static_cast<R_C_Filter*> (streams[l]->get_filters()[n].get())->get_state();
+			if (state.size() > 1) state[0] = lastIn[l];
+			state.back() = lastOut[l];
+		}
+	}
+	for (quint32 l = 0; l < lanes; l++) {
+		R_C_Filter* last = static_cast<R_C_Filter*> (streams[l]->get_filters().back().get());
+		if (last->get_size() != size) last->set_size(size);
+		float* out = last->output_data().data();
+		for (quint32 i = 0; i < size; i++) out[i] = data[i*maxLanes + l];
+		streams[l]->set_output(last->get_data());
+	}
 }
 
 FilteringProcessor::FilteringProcessor (quint32 size) : QObject(), dataSize (size) {
@@ -598,13 +1893,28 @@ FilteringProcessor::~FilteringProcessor () {
 void FilteringProcessor::process() {
 	mutex.lock();
 	bool running = false;
+	std::vector<std::vector<FilteringThread*>> laneGroups;
 	for (quint32 i = 0, ie = filterStreams.size(); i < ie; i++) {
 		filterStreams[i]->set_input(inputPtrs[i]);
-		if (filterStreams[i]->get_filter_count() && filterStreams[i]->get_enabled()) {
+		if (isLaned && filterStreams[i]->is_lane_chain()) {
+			quint32 g = 0;
+			while (g < laneGroups.size() && (laneGroups[g].size() == IIRLanes::maxLanes ||
+											 !laneGroups[g][0]->same_chain(filterStreams[i]))) g++;
+			if (g == laneGroups.size()) laneGroups.push_back(std::vector<FilteringThread*> ());
+			laneGroups[g].push_back(filterStreams[i]);
+		}
+		else if (filterStreams[i]->get_filter_count() && filterStreams[i]->get_enabled()) {
 			thisPool->start(filterStreams[i]);
 			running = true;
 		}
 	}
+	for (auto& a: laneGroups) {
+		if (a.size() > 1 || isChunked) iirLanes.process(a);
+		else {
+			thisPool->start(a[0]);
+			running = true;
+		}
+	}
 	if (running) thisPool->waitForDone();
 	finished();
 	mutex.unlock();
@@ -614,6 +1924,7 @@ void FilteringProcessor::set_streams(quint32 streams) {
 	mutex.lock();
 	while (filterStreams.size() < streams) {
 		filterStreams.push_back(new FilteringThread (dataSize));
+		filterStreams.back()->set_fused(isFused);
 	}
 	while (filterStreams.size() > streams) {
 		delete filterStreams[filterStreams.size()-1];
@@ -634,6 +1945,7 @@ void FilteringProcessor::set_size(quint32 size) {
 }
 
 void FilteringProcessor::save_settings(std::ostream &os) const {
+	QMutexLocker locker (&mutex);
 	quint32 tmp = filterStreams.size();
 	os.write("SHPR", 4);
 	os.write((char*)&dataSize, 4);
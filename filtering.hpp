@@ -30,7 +30,9 @@
 #include <cassert>
 #include <memory>
 #include <cmath>
+#include <complex>
 #include <iostream>
+#include "fft.hpp"
 
 class FilteringProcessor;
 
@@ -49,7 +51,7 @@ class Filter {
 		quint32 get_size() const
 			{ return output.size(); }
 		void set_data (std::vector<float> const* data)
-			{ assert (data->size() == output.size()); inputPtr = data; }
+			{ assert (data->size() == output.size()*get_decimation()); inputPtr = data; }
 		std::vector<float> const* get_data () const
 			{ return &output; }
 		void clear_buffer ()
@@ -58,6 +60,13 @@ class Filter {
 		virtual void save_settings (std::ostream& os) const = 0;
 		virtual void load_settings (std::istream& is) = 0;
 		virtual void process() = 0;
+		// True if cutting the stream into pieces of at least blockSize
+		// samples gives the same output as processing whole buffers.
+		virtual bool is_streamable (quint32 blockSize) const
+			{ (void)blockSize; return true; }
+		// Input samples per output sample
+		virtual quint32 get_decimation () const
+			{ return 1; }
 
 		class FilterSettings {
 			public:
@@ -71,21 +80,63 @@ class Filter {
 		virtual std::shared_ptr<FilterSettings> get () = 0;
 };
 
+class FFTConvolver {
+
+		std::shared_ptr<const FFTPlan<float>> plan;
+		std::vector<std::complex<float>> kernelSpectrum;
+		std::vector<std::complex<float>> spectra;
+		std::vector<float> frames;
+		quint32 kernelSize = 0;
+		quint32 blockSize = 0;
+
+	public:
+		FFTConvolver() {}
+		void set_kernel (const std::vector<float>& shape);
+		quint32 get_kernel_size () const
+			{ return kernelSize; }
+		void process (const float* staged, float* out, quint32 size);
+};
+
 class Shaper : public Filter {
 
+		FFTConvolver fftConv;
+		bool useFFT = false;
+
+		static quint32 calibrate_fft_crossover ();
+
 	protected:
 		std::vector<float> shape;
+		std::vector<float> staging;
 		virtual void set_shape() = 0;
+		void shape_changed ();
+		void stage_input ();
+		void keep_history ();
 	public:
 		Shaper(quint32 dataSize) : Filter (dataSize) {}
 		void process();
+		bool is_streamable (quint32 blockSize) const
+			{ (void)blockSize; return !useFFT; }
+		static quint32 fft_crossover ();
 };
 
 class FilteringThread : public QRunnable {
 		std::vector<std::shared_ptr<Filter>> filters;
 		std::vector<float> const* inputPtr;
+		std::vector<float> const* outputPtr = 0x0;
 		quint32 size;
 		bool isEnabled;
+		bool isFused = true;
+
+		// Fused mode: runs of streamable filters are processed block by block
+		// of 4 KiB, so intermediate outputs stay in L1. Buffers shorter than
+		// fusedMinBlocks blocks are run filter by filter.
+		static const quint32 fusedBlockSize = 1024;
+		static const quint32 fusedMinBlocks = 2;
+		std::vector<float> blockInput;
+		std::vector<float> fusedOutput;
+
+		void process_filter (quint32 filter_num, std::vector<float> const* data);
+		void fit_decimation ();
 
 	public:
 		FilteringThread(quint32 dataSize);
@@ -95,11 +146,26 @@ class FilteringThread : public QRunnable {
 			{ isEnabled = state; }
 		bool get_enabled () const
 			{ return isEnabled; }
+		void set_fused (bool state)
+			{ isFused = state; }
+		bool get_fused () const
+			{ return isFused; }
 		void set_size (quint32 size);
+		quint32 get_size () const
+			{ return size; }
 		void set_input (std::vector<float> const* input);
+		std::vector<float> const* get_input () const
+			{ return inputPtr; }
 		std::vector<float> const* get_output () const;
+		void set_output (std::vector<float> const* output)
+			{ outputPtr = output; }
+		quint32 get_decimation () const;
+		std::vector<std::shared_ptr<Filter>> const& get_filters () const
+			{ return filters; }
+		bool is_lane_chain () const;
+		bool same_chain (FilteringThread const* a) const;
 		void set (std::shared_ptr<Filter::FilterSettings> settings, quint32 filter_num)
-			{ assert (filter_num < filters.size()); filters[filter_num]->set (settings); }
+			{ assert (filter_num < filters.size()); filters[filter_num]->set (settings); fit_decimation(); }
 		std::shared_ptr<Filter::FilterSettings> get (quint32 filter_num)
 			{ assert (filter_num < filters.size()); return filters[filter_num]->get(); }
 		void add_filter (quint32 filter_id);
@@ -111,6 +177,23 @@ class FilteringThread : public QRunnable {
 		void load_settings (std::istream& is);
 };
 
+// Runs streams made only of RC/CR/CR_REV filters. Streams with the same chain
+// are interleaved and processed lane-parallel, a lone stream is split into
+// chunks that run in parallel and are then joined by a carry pass.
+
+class IIRLanes {
+		std::vector<float> data;
+		std::vector<float> powers;
+		std::vector<double> powersDouble;
+
+		void process_single (FilteringThread* stream);
+
+	public:
+		static const quint32 maxLanes = 8;
+		static bool is_lane_filter (quint32 filter_id);
+		void process (std::vector<FilteringThread*> const& streams);
+};
+
 class FilteringProcessor : public QObject {
 		Q_OBJECT
 
@@ -118,7 +201,13 @@ class FilteringProcessor : public QObject {
 		quint32 dataSize;
 		std::vector<FilteringThread*> filterStreams;
 		std::shared_ptr<QThreadPool> thisPool;
-		QMutex mutex;
+		mutable QMutex mutex;
+		bool isFused = true;
+		bool isLaned = true;
+		// A lone RC/CR chain solved in parallel chunks, rounds differently
+		// from the per-stream filters so it is off unless asked for
+		bool isChunked = false;
+		IIRLanes iirLanes;
 	public:
 		FilteringProcessor(quint32 size);
 		FilteringProcessor (const FilteringProcessor&) = delete;
@@ -129,6 +218,18 @@ class FilteringProcessor : public QObject {
 			{  assert(stream < filterStreams.size()); mutex.lock(); filterStreams[stream]->set_enabled(state); mutex.unlock(); }
 		bool get_enabled (quint32 stream) const
 			{ assert(stream < filterStreams.size()); return filterStreams[stream]->get_enabled(); }
+		void set_fused (bool state)
+			{ mutex.lock(); isFused = state; for (auto a: filterStreams) a->set_fused(state); mutex.unlock(); }
+		bool get_fused () const
+			{ return isFused; }
+		void set_iir_lanes (bool state)
+			{ mutex.lock(); isLaned = state; mutex.unlock(); }
+		bool get_iir_lanes () const
+			{ return isLaned; }
+		void set_iir_chunks (bool state)
+			{ mutex.lock(); isChunked = state; mutex.unlock(); }
+		bool get_iir_chunks () const
+			{ return isChunked; }
 
 		void set_streams (quint32 streams);
 		quint32 get_streams () const { return filterStreams.size(); }
@@ -150,11 +251,14 @@ class FilteringProcessor : public QObject {
 			{ assert(stream < filterStreams.size());  mutex.lock(); inputPtrs[stream] = input; mutex.unlock(); }
 		std::vector<float> const* get_output (quint32 stream) const
 			{ assert(stream < filterStreams.size()); return filterStreams[stream]->get_output(); }
+		quint32 get_decimation (quint32 stream) const
+			{ assert(stream < filterStreams.size()); return filterStreams[stream]->get_enabled() ? filterStreams[stream]->get_decimation() : 1; }
 
 		void set (std::shared_ptr<Filter::FilterSettings> settings, quint32 stream, quint32 filter_num)
 			{ assert(stream < filterStreams.size()); mutex.lock(); filterStreams[stream]->set(settings, filter_num); mutex.unlock(); }
+		// Locked, filters such as MatchedFilter update their settings in process()
 		std::shared_ptr<Filter::FilterSettings> get (quint32 stream, quint32 filter_num) const
-			{ assert(stream < filterStreams.size()); return filterStreams[stream]->get(filter_num); }
+			{ assert(stream < filterStreams.size()); QMutexLocker locker (&mutex); return filterStreams[stream]->get(filter_num); }
 
 		void save_settings (std::ostream& os) const;
 		void load_settings (std::istream& is);
@@ -170,6 +274,11 @@ class FilteringProcessor : public QObject {
 			Trapezoidal,
 			Gaussian,
 			Cusp,
+			Biquad,
+			PoleZero,
+			BaselineRestorer,
+			Decimator,
+			Matched,
 			TotalAvailable
 		};
 
@@ -194,6 +303,8 @@ class Delay : public Filter {
 		void save_settings(std::ostream& os) const;
 		void load_settings(std::istream& is);
 		void process();
+		bool is_streamable (quint32 blockSize) const
+			{ return delayTime <= blockSize; }
 
 		class Settings : public FilterSettings {
 			public:
@@ -217,6 +328,8 @@ class DelayLine : public Filter {
 		void save_settings(std::ostream& os) const;
 		void load_settings(std::istream& is);
 		void process();
+		bool is_streamable (quint32 blockSize) const
+			{ return delayTime <= blockSize; }
 
 		class Settings : public FilterSettings {
 			public:
@@ -241,6 +354,8 @@ class OverrunLine : public Filter {
 		void save_settings(std::ostream& os) const;
 		void load_settings(std::istream& is);
 		void process();
+		bool is_streamable (quint32 blockSize) const
+			{ return overrunTime <= blockSize; }
 
 		class Settings : public FilterSettings {
 			public:
@@ -270,6 +385,15 @@ class R_C_Filter : public Filter {
 		virtual quint32 get_filter_id() const = 0;
 		virtual void process() = 0;
 
+		// Lane engine access. State is {last output} for RC and
+		// {last input, last output} for CR and CR_REV.
+		float get_alpha () const
+			{ return alpha; }
+		std::vector<float>& get_state ()
+			{ return buffer; }
+		std::vector<float>& output_data ()
+			{ return output; }
+
 		class RC_Settings : public FilterSettings {
 			public:
 				RC_Settings& operator= (const FilterSettings& a);
@@ -302,7 +426,7 @@ class CR_IIR_Filter : public R_C_Filter {
 
 	public:
 
-		CR_IIR_Filter (quint32 dataSize) : R_C_Filter (dataSize) {}
+		CR_IIR_Filter (quint32 dataSize) : R_C_Filter (dataSize) { buffer.resize(2, 0.f); }
 		~CR_IIR_Filter () {}
 
 		std::shared_ptr<FilterSettings> get ();
@@ -322,7 +446,7 @@ class CR_REV_IIR_Filter : public R_C_Filter {
 
 	public:
 
-		CR_REV_IIR_Filter (quint32 dataSize) : R_C_Filter (dataSize) {}
+		CR_REV_IIR_Filter (quint32 dataSize) : R_C_Filter (dataSize) { buffer.resize(2, 0.f); }
 		~CR_REV_IIR_Filter () {}
 
 		std::shared_ptr<FilterSettings> get ();
@@ -339,7 +463,10 @@ class CR_REV_IIR_Filter : public R_C_Filter {
 
 class MovingAverage : public Shaper {
 		quint32 size = 3;
+		static const quint32 directMaxSize = 16;
 
+		// Running sum over the staged [history | input] window, the sum
+		// is recomputed from the history at each buffer start.
 		void set_shape();
 
 	public:
@@ -351,6 +478,9 @@ class MovingAverage : public Shaper {
 		quint32 get_filter_id () const;
 		void save_settings(std::ostream& os) const;
 		void load_settings(std::istream& is);
+		void process();
+		bool is_streamable (quint32 blockSize) const
+			{ (void)blockSize; return size <= directMaxSize; }
 
 		class Settings : public FilterSettings {
 			public:
@@ -365,11 +495,21 @@ class TrapezoidalShaper : public Shaper {
 		quint32 sideSz = 3;
 		quint32 flatSz = 2;
 
+		// Recursive form: trapezoid is a box of sideSz convolved with a box
+		// of sideSz + flatSz, both kept as running sums over delay lines.
+		std::vector<double> inputDelay;
+		std::vector<double> sumDelay;
+		quint32 inputDelayPos = 0;
+		quint32 sumDelayPos = 0;
+		double sideSum = 0.;
+		double trapSum = 0.;
+
 		void set_shape();
 
 	public:
-		TrapezoidalShaper(quint32 dataSize) : Shaper (dataSize) {}
+		TrapezoidalShaper(quint32 dataSize) : Shaper (dataSize) { set_shape(); }
 		~TrapezoidalShaper() {}
+		void process();
 
 		void set (std::shared_ptr<FilterSettings> settings);
 		std::shared_ptr<FilterSettings> get ();
@@ -439,4 +579,243 @@ class CuspShaper : public Shaper {
 
 };
 
+class BiquadCascade : public Filter {
+	public:
+		struct Section {
+			double b0, b1, b2, a1, a2;
+		};
+
+		enum Designs {
+			CR_RC = 0,
+			ButterworthLP,
+			ButterworthHP,
+			BesselLP,
+			TotalDesigns
+		};
+
+		// Design helpers. Cutoff is a fraction of the sample rate, tau is in samples.
+		static std::vector<Section> design_cr_rc (quint32 order, double tau);
+		static std::vector<Section> design_butterworth (quint32 order, double cutoff, bool highPass);
+		static std::vector<Section> design_bessel (quint32 order, double cutoff);
+		static std::complex<double> response (const std::vector<Section>& sections, std::complex<double> z);
+
+	private:
+		quint32 design = CR_RC;
+		quint32 order = 4;
+		float tau = 8.f;
+		float cutoff = 0.05f;
+
+		// Transposed direct form II, state is {z1, z2} per section
+		std::vector<Section> sections;
+		std::vector<double> state;
+		std::vector<double> work;
+
+		void set_sections();
+
+	public:
+		BiquadCascade(quint32 dataSize) : Filter (dataSize) { set_sections(); }
+		~BiquadCascade() {}
+
+		void set (std::shared_ptr<FilterSettings> settings);
+		std::shared_ptr<FilterSettings> get ();
+
+		quint32 get_filter_id () const;
+		void save_settings(std::ostream& os) const;
+		void load_settings(std::istream& is);
+		void process();
+
+		class Settings : public FilterSettings {
+			public:
+				quint32 get_filter_id() const { return FilteringProcessor::Biquad; }
+				Settings& operator= (const FilterSettings& a);
+				quint32 design = CR_RC;
+				quint32 order = 4;
+				float tau = 8.f;
+				float cutoff = 0.05f;
+		};
+
+};
+
+class PoleZeroFilter : public Filter {
+		// y = p*y[-1] + x - d*x[-1]: the zero at d = exp(-1/decay) cancels the
+		// preamp pole, the new pole p = exp(-1/tau) sets the output decay.
+		float decay = 1000.f;
+		float tau = 100.f;
+		double zero = 0.;
+		double pole = 0.;
+		double lastIn = 0.;
+		double lastOut = 0.;
+
+		void set_coefs();
+
+	public:
+		PoleZeroFilter(quint32 dataSize) : Filter (dataSize) { set_coefs(); }
+		~PoleZeroFilter() {}
+
+		void set (std::shared_ptr<FilterSettings> settings);
+		std::shared_ptr<FilterSettings> get ();
+
+		quint32 get_filter_id () const;
+		void save_settings(std::ostream& os) const;
+		void load_settings(std::istream& is);
+		void process();
+
+		class Settings : public FilterSettings {
+			public:
+				quint32 get_filter_id() const { return FilteringProcessor::PoleZero; }
+				Settings& operator= (const FilterSettings& a);
+				float decay = 1000.f;
+				float tau = 100.f;
+		};
+
+};
+
+class BaselineRestorer : public Filter {
+		// Baseline is an exponential average of samples outside pulses. A sample
+		// deviating by more than threshold closes the gate, it reopens holdoff
+		// samples after the last such sample.
+		float threshold = 0.1f;
+		quint32 window = 64;
+		quint32 holdoff = 32;
+		double baseline = 0.;
+		quint32 gateCounter = 0;
+		quint32 gatedSamples = 0;
+
+	public:
+		BaselineRestorer(quint32 dataSize) : Filter (dataSize) {}
+		~BaselineRestorer() {}
+
+		void set (std::shared_ptr<FilterSettings> settings);
+		std::shared_ptr<FilterSettings> get ();
+
+		quint32 get_filter_id () const;
+		void save_settings(std::ostream& os) const;
+		void load_settings(std::istream& is);
+		void process();
+
+		class Settings : public FilterSettings {
+			public:
+				quint32 get_filter_id() const { return FilteringProcessor::BaselineRestorer; }
+				Settings& operator= (const FilterSettings& a);
+				float threshold = 0.1f;
+				quint32 window = 64;
+				quint32 holdoff = 32;
+		};
+
+};
+
+class DecimationFilter : public Filter {
+		// Polyphase FIR: the anti-alias kernel is split into ratio phases and
+		// each phase runs at the output rate on every ratio-th input sample.
+		quint32 ratio = 4;
+		quint32 tapsPerPhase = 16;
+		float bandwidth = 0.8f;
+		std::vector<std::vector<float>> phases;
+		std::vector<float> staging;
+		std::vector<float> phaseOut;
+
+		void set_phases();
+
+	public:
+		DecimationFilter(quint32 dataSize) : Filter (dataSize) { set_phases(); }
+		~DecimationFilter() {}
+
+		void set (std::shared_ptr<FilterSettings> settings);
+		std::shared_ptr<FilterSettings> get ();
+
+		// Blackman windowed sinc of ratio*tapsPerPhase taps, cut off at
+		// bandwidth times the output Nyquist frequency, unity gain at DC
+		static std::vector<float> design_kernel (quint32 ratio, quint32 tapsPerPhase, float bandwidth);
+
+		quint32 get_filter_id () const;
+		void save_settings(std::ostream& os) const;
+		void load_settings(std::istream& is);
+		void process();
+		bool is_streamable (quint32 blockSize) const
+			{ (void)blockSize; return false; }
+		quint32 get_decimation () const
+			{ return ratio; }
+
+		class Settings : public FilterSettings {
+			public:
+				quint32 get_filter_id() const { return FilteringProcessor::Decimator; }
+				Settings& operator= (const FilterSettings& a);
+				quint32 ratio = 4;
+				quint32 tapsPerPhase = 16;
+				float bandwidth = 0.8f;
+		};
+
+};
+
+class MatchedFilter : public Shaper {
+		// Correlates the input with the pulse shape divided by the noise power
+		// spectrum, peak output equals the pulse amplitude. Noise is measured
+		// on the filter input as an average of Hann windowed periodograms,
+		// segments containing a pulse are skipped. After psdMaxRejected skipped
+		// segments the measurement ends with the segments it has, or fails.
+		static const quint32 psdAverages = 64;
+		static const quint32 psdMaxRejected = 16*psdAverages;
+		quint32 mode = 0;
+		quint32 kernelSize = 256;
+		float amplitude = 1.f;
+		std::vector<float> pulse;
+		std::vector<float> noisePSD;
+		bool measureNoise = false;
+		bool measureFailed = false;
+		FFT<float> fft;
+		std::vector<float> segment;
+		std::vector<float> gate;
+		std::vector<double> psdSum;
+		quint32 psdSegments = 0;
+		quint32 psdRejected = 0;
+
+		void set_shape();
+		bool has_pulse ();
+		void finish_psd ();
+		void accumulate_psd();
+
+	public:
+		MatchedFilter(quint32 dataSize) : Shaper (dataSize), fft(2) { set_shape(); }
+		~MatchedFilter() {}
+
+		enum Modes {
+			MatchedMode = 0,
+			WienerMode,
+			TotalModes
+		};
+
+		void set (std::shared_ptr<FilterSettings> settings);
+		std::shared_ptr<FilterSettings> get ();
+
+		// Correlation kernel of kernelSize taps. noisePSD holds kernelSize/2 bins
+		// in units of |FFT|^2 of a kernelSize block, empty means white noise of
+		// unit variance. The Wiener regularisation weighs the pulse, scaled to
+		// 'amplitude' at its peak, against this noise.
+		static std::vector<float> design_kernel (const std::vector<float>& pulse, const std::vector<float>& noisePSD,
+												 quint32 kernelSize, quint32 mode, float amplitude = 1.f);
+
+		quint32 get_filter_id () const;
+		void save_settings(std::ostream& os) const;
+		void load_settings(std::istream& is);
+		void process();
+		bool is_streamable (quint32 blockSize) const
+			{ return !measureNoise && Shaper::is_streamable(blockSize); }
+
+		class Settings : public FilterSettings {
+			public:
+				quint32 get_filter_id() const { return FilteringProcessor::Matched; }
+				Settings& operator= (const FilterSettings& a);
+				quint32 mode = 0;
+				quint32 kernelSize = 256;
+				// Expected pulse amplitude at the filter input, Wiener mode only
+				float amplitude = 1.f;
+				std::vector<float> pulse;
+				std::vector<float> noisePSD;
+				bool measureNoise = false;
+				// Set by get() when the last measurement saw only pulses
+				bool measureFailed = false;
+		};
+
+};
+
 #endif // FILTERING_HPP
@@ -42,6 +42,11 @@ FilteringDialog::FilteringDialog(Core* core, QWidget* parent) : QDialog (parent)
 	filterAddCB->addItem(tr("Trapezoidal shaper"), QVariant((quint32)FilteringProcessor::Trapezoidal));
 	filterAddCB->addItem(tr("Gaussian shaper"), QVariant((quint32)FilteringProcessor::Gaussian));
 	filterAddCB->addItem(tr("Cusp shaper"), QVariant((quint32)FilteringProcessor::Cusp));
+	filterAddCB->addItem(tr("Biquad cascade"), QVariant((quint32)FilteringProcessor::Biquad));
+	filterAddCB->addItem(tr("Pole-zero cancellation"), QVariant((quint32)FilteringProcessor::PoleZero));
+	filterAddCB->addItem(tr("Baseline restorer"), QVariant((quint32)FilteringProcessor::BaselineRestorer));
+	filterAddCB->addItem(tr("Decimator"), QVariant((quint32)FilteringProcessor::Decimator));
+	filterAddCB->addItem(tr("Matched filter"), QVariant((quint32)FilteringProcessor::Matched));
 
 	mainLayout = new QVBoxLayout (this);
 	strmLayout = new QHBoxLayout;
@@ -71,6 +76,11 @@ FilteringDialog::FilteringDialog(Core* core, QWidget* parent) : QDialog (parent)
 	filDialogs.push_back(std::shared_ptr<ShaperDialog> (new TrapezoidalDialog (this)));
 	filDialogs.push_back(std::shared_ptr<ShaperDialog> (new GaussianDialog (this)));
 	filDialogs.push_back(std::shared_ptr<ShaperDialog> (new CuspDialog (this)));
+	filDialogs.push_back(std::shared_ptr<ShaperDialog> (new BiquadDialog (this)));
+	filDialogs.push_back(std::shared_ptr<ShaperDialog> (new PoleZeroDialog (this)));
+	filDialogs.push_back(std::shared_ptr<ShaperDialog> (new BaselineRestorerDialog (this)));
+	filDialogs.push_back(std::shared_ptr<ShaperDialog> (new DecimationDialog (this)));
+	filDialogs.push_back(std::shared_ptr<ShaperDialog> (new MatchedFilterDialog (core, this)));
 	for (auto& a: filDialogs) a->setModal(true);
 
 	connect (acceptPB, SIGNAL(clicked(bool)), this, SLOT(accept()));
@@ -135,6 +145,21 @@ void FilteringDialog::reload_settings() {
 				case FilteringProcessor::Cusp:
 					ref.push_back(std::shared_ptr<Filter::FilterSettings> (new CuspShaper::Settings));
 					break;
+				case FilteringProcessor::Biquad:
+					ref.push_back(std::shared_ptr<Filter::FilterSettings> (new BiquadCascade::Settings));
+					break;
+				case FilteringProcessor::PoleZero:
+					ref.push_back(std::shared_ptr<Filter::FilterSettings> (new PoleZeroFilter::Settings));
+					break;
+				case FilteringProcessor::BaselineRestorer:
+					ref.push_back(std::shared_ptr<Filter::FilterSettings> (new BaselineRestorer::Settings));
+					break;
+				case FilteringProcessor::Decimator:
+					ref.push_back(std::shared_ptr<Filter::FilterSettings> (new DecimationFilter::Settings));
+					break;
+				case FilteringProcessor::Matched:
+					ref.push_back(std::shared_ptr<Filter::FilterSettings> (new MatchedFilter::Settings));
+					break;
 				default:
 					assert(false);
 			}
@@ -200,6 +225,21 @@ void FilteringDialog::update_widgets() {
 			case FilteringProcessor::Cusp:
 				filterTypeLabel[i]->setText(tr("Cusp shaper"));
 				break;
+			case FilteringProcessor::Biquad:
+				filterTypeLabel[i]->setText(tr("Biquad cascade"));
+				break;
+			case FilteringProcessor::PoleZero:
+				filterTypeLabel[i]->setText(tr("Pole-zero cancellation"));
+				break;
+			case FilteringProcessor::BaselineRestorer:
+				filterTypeLabel[i]->setText(tr("Baseline restorer"));
+				break;
+			case FilteringProcessor::Decimator:
+				filterTypeLabel[i]->setText(tr("Decimator"));
+				break;
+			case FilteringProcessor::Matched:
+				filterTypeLabel[i]->setText(tr("Matched filter"));
+				break;
 			default:
 				assert(false);
 		}
@@ -209,6 +249,7 @@ void FilteringDialog::update_widgets() {
 }
 
 void FilteringDialog::accept() {
+	std::vector<quint32> oldRates = get_rates();
 	for (quint32 i = 0, ie = filterSettings.size(); i < ie; i++) {
 		while (coreClassPtr->get_filters_count(i) < filterSettings[i].size()) {
 			coreClassPtr->add_filter(filterSettings[i][coreClassPtr->get_filters_count(i)]->get_filter_id(), i);
@@ -222,10 +263,12 @@ void FilteringDialog::accept() {
 		}
 		coreClassPtr->set_filter_enabled(filterEnabled[i], i);
 	}
+	check_rates(oldRates);
 	QDialog::accept();
 }
 
 void FilteringDialog::apply() {
+	std::vector<quint32> oldRates = get_rates();
 	quint32 i = streamCB->currentData().toUInt();
 	while (coreClassPtr->get_filters_count(i) < filterSettings[i].size()) {
 		coreClassPtr->add_filter(filterSettings[i][coreClassPtr->get_filters_count(i)]->get_filter_id(), i);
@@ -238,6 +281,33 @@ void FilteringDialog::apply() {
 		coreClassPtr->filter_set(filterSettings[i][n], i, n);
 	}
 	coreClassPtr->set_filter_enabled(filterEnabled[i], i);
+	check_rates(oldRates);
+}
+
+std::vector<quint32> FilteringDialog::get_rates() const {
+	std::vector<quint32> rates (coreClassPtr->get_input_streams());
+	for (quint32 i = 0, ie = rates.size(); i < ie; i++) rates[i] = coreClassPtr->get_effective_sample_rate(i);
+	return rates;
+}
+
+// Processing settings are counted in samples and are not rescaled, warn
+// when a decimator changes the rate they are measured at
+void FilteringDialog::check_rates(const std::vector<quint32> &oldRates) {
+	std::vector<quint32> newRates = get_rates();
+	QString streams;
+	for (quint32 i = 0, ie = std::min(oldRates.size(), newRates.size()); i < ie; i++) {
+		if (oldRates[i] == newRates[i]) continue;
+		streams += QString("%1: %2 Hz -> %3 Hz\n").arg(coreClassPtr->get_input_name(i)).arg(oldRates[i]).arg(newRates[i]);
+	}
+	if (streams.isEmpty()) return;
+	QMessageBox msg (this);
+	msg.setIcon(QMessageBox::Warning);
+	msg.setText(tr("Decimation changed the sample rate of the processed data."));
+	msg.setInformativeText(streams + tr("\nPulse size, search, amplitude and time settings, maximal time "
+										"difference, captured shapes and neural networks of the processing "
+										"threads on these streams are counted in samples and now cover a "
+										"different time. Times in the spectra are measured in the new samples."));
+	msg.exec();
 }
 
 void FilteringDialog::add() {
@@ -272,6 +342,21 @@ void FilteringDialog::add() {
 		} case FilteringProcessor::Cusp: {
 			filterSettings[streamCB->currentData().toUInt()].push_back (std::shared_ptr<Filter::FilterSettings> (new CuspShaper::Settings));
 			break;
+		} case FilteringProcessor::Biquad: {
+			filterSettings[streamCB->currentData().toUInt()].push_back (std::shared_ptr<Filter::FilterSettings> (new BiquadCascade::Settings));
+			break;
+		} case FilteringProcessor::PoleZero: {
+			filterSettings[streamCB->currentData().toUInt()].push_back (std::shared_ptr<Filter::FilterSettings> (new PoleZeroFilter::Settings));
+			break;
+		} case FilteringProcessor::BaselineRestorer: {
+			filterSettings[streamCB->currentData().toUInt()].push_back (std::shared_ptr<Filter::FilterSettings> (new BaselineRestorer::Settings));
+			break;
+		} case FilteringProcessor::Decimator: {
+			filterSettings[streamCB->currentData().toUInt()].push_back (std::shared_ptr<Filter::FilterSettings> (new DecimationFilter::Settings));
+			break;
+		} case FilteringProcessor::Matched: {
+			filterSettings[streamCB->currentData().toUInt()].push_back (std::shared_ptr<Filter::FilterSettings> (new MatchedFilter::Settings));
+			break;
 		} default:
 			assert(false);
 	}
@@ -456,7 +541,7 @@ MovingAverageDialog::MovingAverageDialog (QWidget* parent) : ShaperDialog (paren
 	sizeLabel = new QLabel (tr("N"), this);
 	size = new QSpinBox (this);
 	size->setMinimum(1);
-	size->setMaximum(32);
+	size->setMaximum(1024);
 	mainLayout->addWidget(infoLabel, 0, 0, 1, 2);
 	mainLayout->addWidget(sizeLabel, 1, 0, 1, 1);
 	mainLayout->addWidget(size, 1, 1, 1, 1);
@@ -555,3 +640,229 @@ void CuspDialog::accept() {
 	QDialog::accept();
 }
 
+BiquadDialog::BiquadDialog (QWidget* parent) : ShaperDialog (parent) {
+	infoLabel->setText("This is IIR filter built of second order sections.<br>Tau is used by CR-RC, cutoff (in sample rate units) by the others.");
+	designLabel = new QLabel (tr("Design"), this);
+	orderLabel = new QLabel (tr("Order"), this);
+	tauLabel = new QLabel (tr("Tau"), this);
+	cutoffLabel = new QLabel (tr("Cutoff"), this);
+	design = new QComboBox (this);
+	order = new QSpinBox (this);
+	tau = new QDoubleSpinBox (this);
+	cutoff = new QDoubleSpinBox (this);
+	design->addItem(tr("CR-RC^n"), QVariant((quint32)BiquadCascade::CR_RC));
+	design->addItem(tr("Butterworth low-pass"), QVariant((quint32)BiquadCascade::ButterworthLP));
+	design->addItem(tr("Butterworth high-pass"), QVariant((quint32)BiquadCascade::ButterworthHP));
+	design->addItem(tr("Bessel low-pass"), QVariant((quint32)BiquadCascade::BesselLP));
+	order->setMinimum(1);
+	order->setMaximum(8);
+	tau->setMinimum(0.5);
+	tau->setMaximum(1000.);
+	cutoff->setMinimum(0.001);
+	cutoff->setMaximum(0.499);
+	cutoff->setDecimals(3);
+	cutoff->setSingleStep(0.001);
+	mainLayout->addWidget(infoLabel, 0, 0, 1, 2);
+	mainLayout->addWidget(designLabel, 1, 0, 1, 1);
+	mainLayout->addWidget(design, 1, 1, 1, 1);
+	mainLayout->addWidget(orderLabel, 2, 0, 1, 1);
+	mainLayout->addWidget(order, 2, 1, 1, 1);
+	mainLayout->addWidget(tauLabel, 3, 0, 1, 1);
+	mainLayout->addWidget(tau, 3, 1, 1, 1);
+	mainLayout->addWidget(cutoffLabel, 4, 0, 1, 1);
+	mainLayout->addWidget(cutoff, 4, 1, 1, 1);
+	mainLayout->addWidget(acceptPB, 6, 0, 1, 1);
+	mainLayout->addWidget(rejectPB, 6, 1, 1, 1);
+}
+
+void BiquadDialog::update_values() {
+	design->setCurrentIndex(design->findData(QVariant(((BiquadCascade::Settings*)settings.get())->design)));
+	order->setValue(((BiquadCascade::Settings*)settings.get())->order);
+	tau->setValue(((BiquadCascade::Settings*)settings.get())->tau);
+	cutoff->setValue(((BiquadCascade::Settings*)settings.get())->cutoff);
+}
+
+void BiquadDialog::accept() {
+	((BiquadCascade::Settings*)settings.get())->design = design->currentData().toUInt();
+	((BiquadCascade::Settings*)settings.get())->order = order->value();
+	((BiquadCascade::Settings*)settings.get())->tau = tau->value();
+	((BiquadCascade::Settings*)settings.get())->cutoff = cutoff->value();
+	QDialog::accept();
+}
+
+PoleZeroDialog::PoleZeroDialog (QWidget* parent) : ShaperDialog (parent) {
+	infoLabel->setText("This is IIR filter. Cancels the exponential tail of preamplifier<br>and replaces it with decay of time constant Tau (in samples).");
+	decayLabel = new QLabel (tr("Preamp decay"), this);
+	tauLabel = new QLabel (tr("Tau"), this);
+	decay = new QDoubleSpinBox (this);
+	tau = new QDoubleSpinBox (this);
+	decay->setMinimum(1.);
+	decay->setMaximum(1000000.);
+	decay->setDecimals(1);
+	tau->setMinimum(1.);
+	tau->setMaximum(1000000.);
+	tau->setDecimals(1);
+	mainLayout->addWidget(infoLabel, 0, 0, 1, 2);
+	mainLayout->addWidget(decayLabel, 1, 0, 1, 1);
+	mainLayout->addWidget(decay, 1, 1, 1, 1);
+	mainLayout->addWidget(tauLabel, 2, 0, 1, 1);
+	mainLayout->addWidget(tau, 2, 1, 1, 1);
+	mainLayout->addWidget(acceptPB, 4, 0, 1, 1);
+	mainLayout->addWidget(rejectPB, 4, 1, 1, 1);
+}
+
+void PoleZeroDialog::update_values() {
+	decay->setValue(((PoleZeroFilter::Settings*)settings.get())->decay);
+	tau->setValue(((PoleZeroFilter::Settings*)settings.get())->tau);
+}
+
+void PoleZeroDialog::accept() {
+	((PoleZeroFilter::Settings*)settings.get())->decay = decay->value();
+	((PoleZeroFilter::Settings*)settings.get())->tau = tau->value();
+	QDialog::accept();
+}
+
+BaselineRestorerDialog::BaselineRestorerDialog (QWidget* parent) : ShaperDialog (parent) {
+	infoLabel->setText("Subtracts running baseline. Baseline is not updated while<br>signal deviates by more than threshold and for holdoff samples after.");
+	thresholdLabel = new QLabel (tr("Threshold"), this);
+	windowLabel = new QLabel (tr("Window"), this);
+	holdoffLabel = new QLabel (tr("Holdoff"), this);
+	threshold = new QDoubleSpinBox (this);
+	window = new QSpinBox (this);
+	holdoff = new QSpinBox (this);
+	threshold->setMinimum(0.);
+	threshold->setMaximum(1.);
+	threshold->setDecimals(4);
+	threshold->setSingleStep(0.001);
+	window->setMinimum(1);
+	window->setMaximum(65536);
+	holdoff->setMinimum(0);
+	holdoff->setMaximum(4096);
+	mainLayout->addWidget(infoLabel, 0, 0, 1, 2);
+	mainLayout->addWidget(thresholdLabel, 1, 0, 1, 1);
+	mainLayout->addWidget(threshold, 1, 1, 1, 1);
+	mainLayout->addWidget(windowLabel, 2, 0, 1, 1);
+	mainLayout->addWidget(window, 2, 1, 1, 1);
+	mainLayout->addWidget(holdoffLabel, 3, 0, 1, 1);
+	mainLayout->addWidget(holdoff, 3, 1, 1, 1);
+	mainLayout->addWidget(acceptPB, 5, 0, 1, 1);
+	mainLayout->addWidget(rejectPB, 5, 1, 1, 1);
+}
+
+void BaselineRestorerDialog::update_values() {
+	threshold->setValue(((BaselineRestorer::Settings*)settings.get())->threshold);
+	window->setValue(((BaselineRestorer::Settings*)settings.get())->window);
+	holdoff->setValue(((BaselineRestorer::Settings*)settings.get())->holdoff);
+}
+
+void BaselineRestorerDialog::accept() {
+	((BaselineRestorer::Settings*)settings.get())->threshold = threshold->value();
+	((BaselineRestorer::Settings*)settings.get())->window = window->value();
+	((BaselineRestorer::Settings*)settings.get())->holdoff = holdoff->value();
+	QDialog::accept();
+}
+
+
+DecimationDialog::DecimationDialog (QWidget* parent) : ShaperDialog (parent) {
+	infoLabel->setText("This is polyphase FIR decimator. Keeps every Ratio-th sample,<br>bandwidth is in units of the output Nyquist frequency.<br>Filters after it and pulse processing work in decimated samples.");
+	ratioLabel = new QLabel (tr("Ratio"), this);
+	tapsLabel = new QLabel (tr("Taps per phase"), this);
+	bandwidthLabel = new QLabel (tr("Bandwidth"), this);
+	ratio = new QComboBox (this);
+	taps = new QSpinBox (this);
+	bandwidth = new QDoubleSpinBox (this);
+	for (quint32 r = 2; r <= 16; r *= 2) ratio->addItem(QString::number(r), QVariant(r));
+	taps->setMinimum(2);
+	taps->setMaximum(64);
+	bandwidth->setMinimum(0.5);
+	bandwidth->setMaximum(1.);
+	bandwidth->setDecimals(2);
+	bandwidth->setSingleStep(0.05);
+	mainLayout->addWidget(infoLabel, 0, 0, 1, 2);
+	mainLayout->addWidget(ratioLabel, 1, 0, 1, 1);
+	mainLayout->addWidget(ratio, 1, 1, 1, 1);
+	mainLayout->addWidget(tapsLabel, 2, 0, 1, 1);
+	mainLayout->addWidget(taps, 2, 1, 1, 1);
+	mainLayout->addWidget(bandwidthLabel, 3, 0, 1, 1);
+	mainLayout->addWidget(bandwidth, 3, 1, 1, 1);
+	mainLayout->addWidget(acceptPB, 5, 0, 1, 1);
+	mainLayout->addWidget(rejectPB, 5, 1, 1, 1);
+}
+
+void DecimationDialog::update_values() {
+	ratio->setCurrentIndex(ratio->findData(QVariant(((DecimationFilter::Settings*)settings.get())->ratio)));
+	taps->setValue(((DecimationFilter::Settings*)settings.get())->tapsPerPhase);
+	bandwidth->setValue(((DecimationFilter::Settings*)settings.get())->bandwidth);
+}
+
+void DecimationDialog::accept() {
+	((DecimationFilter::Settings*)settings.get())->ratio = ratio->currentData().toUInt();
+	((DecimationFilter::Settings*)settings.get())->tapsPerPhase = taps->value();
+	((DecimationFilter::Settings*)settings.get())->bandwidth = bandwidth->value();
+	QDialog::accept();
+}
+
+MatchedFilterDialog::MatchedFilterDialog (Core* core, QWidget* parent) : ShaperDialog (parent) {
+	coreClassPtr = core;
+	infoLabel->setText("This is FIR filter made of pulse shape and noise spectrum.<br>Matched maximizes signal to noise ratio, Wiener also shortens the pulse.<br>Noise is measured on the filter input, it should contain few pulses.<br>Wiener weighs the pulse of the expected amplitude against the noise, with white noise it is the ratio to noise RMS.");
+	modeLabel = new QLabel (tr("Type"), this);
+	amplitudeLabel = new QLabel (tr("Expected amplitude (Wiener)"), this);
+	kernelLabel = new QLabel (tr("Kernel size"), this);
+	pulseLabel = new QLabel (tr("Pulse shape"), this);
+	measureLabel = new QLabel (tr("Measure noise"), this);
+	stateLabel = new QLabel (this);
+	mode = new QComboBox (this);
+	amplitude = new QDoubleSpinBox (this);
+	amplitude->setDecimals(4);
+	amplitude->setRange(0.0001, 100000.);
+	kernel = new QComboBox (this);
+	pulse = new QComboBox (this);
+	measure = new QCheckBox (this);
+	mode->addItem(tr("Matched"), QVariant((quint32)MatchedFilter::MatchedMode));
+	mode->addItem(tr("Wiener"), QVariant((quint32)MatchedFilter::WienerMode));
+	for (quint32 k = 64; k <= 4096; k *= 2) kernel->addItem(QString::number(k), QVariant(k));
+	mainLayout->addWidget(infoLabel, 0, 0, 1, 2);
+	mainLayout->addWidget(modeLabel, 1, 0, 1, 1);
+	mainLayout->addWidget(mode, 1, 1, 1, 1);
+	mainLayout->addWidget(amplitudeLabel, 2, 0, 1, 1);
+	mainLayout->addWidget(amplitude, 2, 1, 1, 1);
+	mainLayout->addWidget(kernelLabel, 3, 0, 1, 1);
+	mainLayout->addWidget(kernel, 3, 1, 1, 1);
+	mainLayout->addWidget(pulseLabel, 4, 0, 1, 1);
+	mainLayout->addWidget(pulse, 4, 1, 1, 1);
+	mainLayout->addWidget(measureLabel, 5, 0, 1, 1);
+	mainLayout->addWidget(measure, 5, 1, 1, 1);
+	mainLayout->addWidget(stateLabel, 6, 0, 1, 2);
+	mainLayout->addWidget(acceptPB, 8, 0, 1, 1);
+	mainLayout->addWidget(rejectPB, 8, 1, 1, 1);
+}
+
+void MatchedFilterDialog::update_values() {
+	MatchedFilter::Settings* set = (MatchedFilter::Settings*)settings.get();
+	mode->setCurrentIndex(mode->findData(QVariant(set->mode)));
+	amplitude->setValue(set->amplitude);
+	kernel->setCurrentIndex(kernel->findData(QVariant(set->kernelSize)));
+	pulse->clear();
+	pulse->addItem(tr("Keep current"), QVariant((qint32)-1));
+	for (quint32 i = 0, ie = coreClassPtr->get_process_threads(); i < ie; i++)
+		if (coreClassPtr->get_process_settings(i)->shape.size())
+			pulse->addItem(coreClassPtr->get_process_name(i), QVariant((qint32)i));
+	measure->setCheckState(set->measureNoise ? Qt::Checked : Qt::Unchecked);
+	QString noise = set->noisePSD.size() ? tr("measured") : tr("white");
+	if (set->measureNoise) noise = tr("being measured");
+	else if (set->measureFailed) noise += tr(", last measurement failed, every segment held a pulse");
+	stateLabel->setText(tr("Pulse shape: %1 samples, noise spectrum: %2").arg(set->pulse.size()).arg(noise));
+}
+
+void MatchedFilterDialog::accept() {
+	MatchedFilter::Settings* set = (MatchedFilter::Settings*)settings.get();
+	quint32 newKernel = kernel->currentData().toUInt();
+	if (newKernel != set->kernelSize) set->noisePSD.clear();
+	set->mode = mode->currentData().toUInt();
+	set->amplitude = amplitude->value();
+	set->kernelSize = newKernel;
+	if (pulse->currentData().toInt() >= 0)
+		set->pulse = coreClassPtr->get_process_settings(pulse->currentData().toInt())->shape;
+	set->measureNoise = measure->checkState() == Qt::Checked;
+	QDialog::accept();
+}
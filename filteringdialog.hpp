@@ -34,6 +34,11 @@ class CRREVIIRDialog;
 class TrapezoidalDialog;
 class GaussianDialog;
 class CuspDialog;
+class BiquadDialog;
+class PoleZeroDialog;
+class BaselineRestorerDialog;
+class DecimationDialog;
+class MatchedFilterDialog;
 
 class FilteringDialog : public QDialog {
 		Q_OBJECT
@@ -66,6 +71,8 @@ class FilteringDialog : public QDialog {
 		void update_streams ();
 		void reload_settings();
 		void update_widgets();
+		std::vector<quint32> get_rates () const;
+		void check_rates (std::vector<quint32> const& oldRates);
 
 	public:
 		explicit FilteringDialog(Core* core, QWidget* parent = 0);
@@ -264,4 +271,106 @@ class CuspDialog : public ShaperDialog {
 
 };
 
+class BiquadDialog : public ShaperDialog {
+		Q_OBJECT
+		QLabel* designLabel;
+		QComboBox* design;
+		QLabel* orderLabel;
+		QSpinBox* order;
+		QLabel* tauLabel;
+		QDoubleSpinBox* tau;
+		QLabel* cutoffLabel;
+		QDoubleSpinBox* cutoff;
+
+		void update_values();
+
+	public:
+		explicit BiquadDialog(QWidget* parent = 0);
+
+	private slots:
+		void accept();
+
+};
+
+class PoleZeroDialog : public ShaperDialog {
+		Q_OBJECT
+		QLabel* decayLabel;
+		QDoubleSpinBox* decay;
+		QLabel* tauLabel;
+		QDoubleSpinBox* tau;
+
+		void update_values();
+
+	public:
+		explicit PoleZeroDialog(QWidget* parent = 0);
+
+	private slots:
+		void accept();
+
+};
+
+class BaselineRestorerDialog : public ShaperDialog {
+		Q_OBJECT
+		QLabel* thresholdLabel;
+		QDoubleSpinBox* threshold;
+		QLabel* windowLabel;
+		QSpinBox* window;
+		QLabel* holdoffLabel;
+		QSpinBox* holdoff;
+
+		void update_values();
+
+	public:
+		explicit BaselineRestorerDialog(QWidget* parent = 0);
+
+	private slots:
+		void accept();
+
+};
+
+class DecimationDialog : public ShaperDialog {
+		Q_OBJECT
+		QLabel* ratioLabel;
+		QComboBox* ratio;
+		QLabel* tapsLabel;
+		QSpinBox* taps;
+		QLabel* bandwidthLabel;
+		QDoubleSpinBox* bandwidth;
+
+		void update_values();
+
+	public:
+		explicit DecimationDialog(QWidget* parent = 0);
+
+	private slots:
+		void accept();
+
+};
+
+class MatchedFilterDialog : public ShaperDialog {
+		Q_OBJECT
+		QLabel* modeLabel;
+		QComboBox* mode;
+		QLabel* amplitudeLabel;
+		QDoubleSpinBox* amplitude;
+		QLabel* kernelLabel;
+		QComboBox* kernel;
+		QLabel* pulseLabel;
+		QComboBox* pulse;
+		QLabel* measureLabel;
+		QCheckBox* measure;
+		QLabel* stateLabel;
+
+		Core* coreClassPtr;
+
+		void update_values();
+
+	public:
+		explicit MatchedFilterDialog(Core* core, QWidget* parent = 0);
+
+	private slots:
+		void accept();
+
+};
+
 #endif // FILTERINGDIALOG_HPP
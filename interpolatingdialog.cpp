@@ -29,12 +29,17 @@ InterpolatingDialog::InterpolatingDialog(Core* _core, QWidget* parent) : QDialog
 	interTypeLab = new QLabel (tr("Interpolaion type"), this);
 	interTypeCB = new QComboBox (this);
 	interTypeCB->addItem(tr("Whittaker-Shannon"), InterpolationClass::WhittakerShannon);
+	interTypeCB->addItem(tr("Cubic (Catmull-Rom)"), InterpolationClass::CubicCatmullRom);
+	interTypeCB->addItem(tr("Lanczos"), InterpolationClass::Lanczos);
+	interTypeCB->addItem(tr("FFT zero padding"), InterpolationClass::FFTZeroPadding);
 	interMultLab = new QLabel (tr("Points multiplication"), this);
 	interMultCB = new QComboBox (this);
 	interMultCB->addItem(tr("2"), QVariant(2u));
 	interMultCB->addItem(tr("4"), QVariant(4u));
 	interMultCB->addItem(tr("8"), QVariant(8u));
 	interMultCB->addItem(tr("16"), QVariant(16u));
+	interMultCB->addItem(tr("32"), QVariant(32u));
+	interMultCB->addItem(tr("64"), QVariant(64u));
 	interPrecLab = new QLabel (tr("Interpolaion precision"), this);
 	interPrecCB = new QComboBox (this);
 	interPrecCB->addItem(tr("4"), QVariant(4u));
@@ -45,6 +50,8 @@ InterpolatingDialog::InterpolatingDialog(Core* _core, QWidget* parent) : QDialog
 	interPrecCB->addItem(tr("128"), QVariant(128u));
 	artReducLab = new QLabel (tr("Artifact reduction"), this);
 	artReducCB = new QCheckBox (this);
+	interLazyLab = new QLabel (tr("Interpolate pulse windows only"), this);
+	interLazyCB = new QCheckBox (this);
 
 	acceptPB = new QPushButton (tr("Accept"), this);
 	rejectPB = new QPushButton (tr("Reject"), this);
@@ -62,6 +69,8 @@ InterpolatingDialog::InterpolatingDialog(Core* _core, QWidget* parent) : QDialog
 	settingsLayout->addWidget(interPrecCB, 3, 1);
 	settingsLayout->addWidget(artReducLab, 4, 0);
 	settingsLayout->addWidget(artReducCB, 4, 1);
+	settingsLayout->addWidget(interLazyLab, 5, 0);
+	settingsLayout->addWidget(interLazyCB, 5, 1);
 
 	mainLayout = new QVBoxLayout (this);
 	mainLayout->addLayout(settingsLayout);
@@ -84,6 +93,8 @@ void InterpolatingDialog::reload_settings() {
 	interPrecCB->setCurrentIndex(get_index(interPrecCB->findData(QVariant(t.precision))));
 	if (t.artifactRedution) artReducCB->setCheckState(Qt::Checked);
 	else artReducCB->setCheckState(Qt::Unchecked);
+	if (CoreClassPtr->get_inter_lazy()) interLazyCB->setCheckState(Qt::Checked);
+	else interLazyCB->setCheckState(Qt::Unchecked);
 }
 
 void InterpolatingDialog::showEvent(QShowEvent *_event) {
@@ -94,6 +105,7 @@ void InterpolatingDialog::showEvent(QShowEvent *_event) {
 void InterpolatingDialog::accept() {
 	InterpolatorSettings t;
 	CoreClassPtr->set_inter_enabled(interEnabledCB->checkState());
+	CoreClassPtr->set_inter_lazy(interLazyCB->checkState());
 	CoreClassPtr->set_inter_type(interTypeCB->currentData().toUInt());
 	t.pointsMult = interMultCB->currentData().toUInt();
 	t.precision = interPrecCB->currentData().toUInt();
@@ -46,6 +46,8 @@ class InterpolatingDialog : public QDialog {
 		QComboBox* interPrecCB;
 		QLabel* artReducLab;
 		QCheckBox* artReducCB;
+		QLabel* interLazyLab;
+		QCheckBox* interLazyCB;
 		QPushButton* acceptPB;
 		QPushButton* rejectPB;
 		QGridLayout* settingsLayout;
@@ -20,6 +20,80 @@
 */
 
 #include "interpolator.hpp"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INTERPOLATOR_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// Output sample i*mult + q is the dot product of staged[i..i+taps) with the
+// kernel of phase q. SIMD variants run over 32 input positions per phase,
+// keeping the summation order of the scalar loop, and then interleave the
+// phases into output order through 'block' (32*mult floats).
+
+typedef void (*PolyphaseFunc) (const float*, const float*, quint32, quint32, float*, quint32, float*);
+
+static void polyphase_direct (const float* staged, const float* phases, quint32 taps, quint32 mult, float* out, quint32 size, float*) {
+	for (quint32 i = 0; i < size; i++) {
+		for (quint32 q = 0; q < mult; q++) {
+			const float* h = phases + q*taps;
+			float acc = 0;
+			for (quint32 n = 0; n < taps; n++) acc += staged[n + i]*h[n];
+			out[i*mult + q] = acc;
+		}
+	}
+}
+
+#ifdef INTERPOLATOR_X86_SIMD
+__attribute__((target("fma")))
+static void polyphase_fma (const float* staged, const float* phases, quint32 taps, quint32 mult, float* out, quint32 size, float*) {
+	for (quint32 i = 0; i < size; i++) {
+		for (quint32 q = 0; q < mult; q++) {
+			const float* h = phases + q*taps;
+			float acc = 0;
+			for (quint32 n = 0; n < taps; n++) acc = __builtin_fmaf(staged[n + i], h[n], acc);
+			out[i*mult + q] = acc;
+		}
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static void polyphase_avx2 (const float* staged, const float* phases, quint32 taps, quint32 mult, float* out, quint32 size, float* block) {
+	quint32 i = 0;
+	for (; i + 32 <= size; i += 32) {
+		for (quint32 q = 0; q < mult; q++) {
+			const float* h = phases + q*taps;
+			__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+			__m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+			for (quint32 n = 0; n < taps; n++) {
+				const float* src = staged + n + i;
+				__m256 k = _mm256_set1_ps(h[n]);
+				acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(src     ), k, acc0);
+				acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(src +  8), k, acc1);
+				acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(src + 16), k, acc2);
+				acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(src + 24), k, acc3);
+			}
+			_mm256_storeu_ps(block + q*32     , acc0);
+			_mm256_storeu_ps(block + q*32 +  8, acc1);
+			_mm256_storeu_ps(block + q*32 + 16, acc2);
+			_mm256_storeu_ps(block + q*32 + 24, acc3);
+		}
+		float* dst = out + i*mult;
+		for (quint32 k = 0; k < 32; k++)
+			for (quint32 q = 0; q < mult; q++) dst[k*mult + q] = block[q*32 + k];
+	}
+	polyphase_fma(staged + i, phases, taps, mult, out + i*mult, size - i, block);
+}
+#endif
+
+static PolyphaseFunc select_polyphase () {
+#ifdef INTERPOLATOR_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return &polyphase_avx2;
+#endif
+	return &polyphase_direct;
+}
+
+static const PolyphaseFunc polyphase = select_polyphase();
 
 Interpolator::Interpolator() {
 }
@@ -41,6 +115,40 @@ void Interpolator::artifact_reduction() {
 	memcpy(output.data() + settings.pointsMult/2, tmpVec.data() + settings.pointsMult/2, sizeof(float)*(output.size()-settings.pointsMult));
 }
 
+void Interpolator::interpolate() {
+	prepare();
+	interpolate_range(0, input->size());
+	finish();
+}
+
+void Interpolator::prepare() {
+	assert (input->size() >= buffer.size());
+	output.resize(input->size()*settings.pointsMult);
+	staged.resize(buffer.size() + input->size());
+	memcpy(staged.data(), buffer.data(), sizeof(float)*buffer.size());
+	memcpy(staged.data() + buffer.size(), input->data(), sizeof(float)*input->size());
+}
+
+void Interpolator::finish() {
+	if (settings.artifactRedution) {
+		artifact_reduction();
+	}
+	memcpy(buffer.data(), input->data() + input->size() - buffer.size(), sizeof(float)*buffer.size());
+}
+
+void Interpolator::interpolate_local(const float* data, quint32 first, quint32 count, float* out) const {
+	const quint32 taps = buffer.size(), mult = settings.pointsMult;
+	assert (first >= mult*(taps/2 - 1) + 1);
+	for (quint32 k = 0; k < count; k++) {
+		quint32 g = first + k - mult*(taps/2 - 1) - 1;
+		quint32 i = g/mult, q = g%mult;
+		float acc = 0.f;
+		for (quint32 n = 0; n < taps; n++)
+			acc += data[i + n]*sinc((float)(mult - 1 - q + n*mult - mult*taps/2)/mult);
+		out[k] = acc;
+	}
+}
+
 void Interpolator::save_settings(std::ostream &os) const {
 	os.write((char*)&settings, sizeof(settings));
 }
@@ -51,54 +159,114 @@ void Interpolator::load_settings(std::istream &is) {
 	set_settings(t);
 }
 
+// Phase q holds the taps of output (i+1)*mult - 1 - (mult - 1 - q), i.e.
+// kernel(n - taps/2 + (mult - 1 - q)/mult) for n = 0..taps-1
+void PolyphaseInterpolator::tabulate_phases() {
+	const int32_t taps = buffer.size(), mult = settings.pointsMult;
+	phases.resize(mult*taps);
+	for (int32_t q = 0; q < mult; q++)
+		for (int32_t n = 0; n < taps; n++)
+			phases[q*taps + n] = kernel((float)(mult - 1 - q + n*mult - mult*taps/2)/mult);
+}
+
+void PolyphaseInterpolator::set_settings(InterpolatorSettings sett) {
+	Interpolator::set_settings(sett);
+	buffer.assign(get_taps(), 0.f);
+	tabulate_phases();
+}
+
+void PolyphaseInterpolator::interpolate_range(quint32 first, quint32 count) {
+	assert (first + count <= input->size());
+	std::vector<float> block (32*settings.pointsMult);
+	polyphase(staged.data() + first, phases.data(), buffer.size(), settings.pointsMult,
+			  output.data() + first*settings.pointsMult, count, block.data());
+}
+
+// Sample f is output q = g%mult of input position i = g/mult of
+// interpolate(), g = f - mult*(taps/2 - 1) - 1
+void PolyphaseInterpolator::interpolate_local(const float* data, quint32 first, quint32 count, float* out) const {
+	const quint32 taps = buffer.size(), mult = settings.pointsMult;
+	assert (first >= mult*(taps/2 - 1) + 1);
+	for (quint32 k = 0; k < count; k++) {
+		quint32 g = first + k - mult*(taps/2 - 1) - 1;
+		const float* x = data + g/mult;
+		const float* h = phases.data() + (g%mult)*taps;
+		float acc = 0.f;
+		for (quint32 n = 0; n < taps; n++) acc += x[n]*h[n];
+		out[k] = acc;
+	}
+}
+
 WhitShanInterpolator::WhitShanInterpolator () {
 	set_settings(InterpolatorSettings());
 }
 
-void WhitShanInterpolator::tabulate_sinc() {
-	sinc_tab.resize(settings.pointsMult*buffer.size());
-	for (int32_t i = 0; i < (int32_t)sinc_tab.size(); i++)
-		sinc_tab[i] = sinc((float)(i-(int32_t)sinc_tab.size()/2)/settings.pointsMult);
+CubicInterpolator::CubicInterpolator () {
+	set_settings(InterpolatorSettings());
+}
+
+float CubicInterpolator::kernel(float delta) const {
+	float x = std::fabs(delta);
+	if (x < 1.f) return 1.5f*x*x*x - 2.5f*x*x + 1.f;
+	if (x < 2.f) return -0.5f*x*x*x + 2.5f*x*x - 4.f*x + 2.f;
+	return 0.f;
+}
+
+LanczosInterpolator::LanczosInterpolator () {
+	set_settings(InterpolatorSettings());
+}
+
+float LanczosInterpolator::kernel(float delta) const {
+	const float a = settings.precision;
+	if (std::fabs(delta) >= a) return 0.f;
+	return sinc(delta)*sinc(delta/a);
 }
 
-void WhitShanInterpolator::set_settings(InterpolatorSettings sett) {
+FFTInterpolator::FFTInterpolator () {
+	set_settings(InterpolatorSettings());
+}
+
+void FFTInterpolator::set_settings(InterpolatorSettings sett) {
 	Interpolator::set_settings(sett);
-	tabulate_sinc();
-}
-
-void WhitShanInterpolator::interpolate() {
-	output.resize(input->size()*settings.pointsMult, 0.f);
-	for (uint32_t i = 0, ie = buffer.size(); i < ie; i++) {
-		uint32_t itmp = (i+1)*settings.pointsMult - 1;
-		for (uint32_t n = 0; n < settings.pointsMult; n++) {
-			output[itmp - n] = 0.f;
-			for (int32_t l = i, le = i + buffer.size(); l < le; l++) {
-				assert (itmp - n < output.size());
-				if ((uint32_t)l < buffer.size()) output[itmp - n] += buffer[l] * sinc_tab[n + (l-i)*settings.pointsMult];
-				else output[itmp-n] += (*input)[l-buffer.size()] * sinc_tab[n + (l-i)*settings.pointsMult];
-			}
-		}
-	}
-	for (uint32_t i = buffer.size(), ie = input->size(); i < ie; i++) {
-		uint32_t itmp = (i+1)*settings.pointsMult - 1;
-		for (uint32_t n = 0; n < settings.pointsMult; n++) {
-			output[itmp - n] = 0.f;
-			for (int32_t l = i, le = i + buffer.size(); l < le; l++) {
-				assert (itmp - n < output.size());
-				assert (l-buffer.size() < input->size());
-				output[itmp-n] += (*input)[l-buffer.size()] * sinc_tab[n + (l-i)*settings.pointsMult];
+	// Guard samples take 2*precision of every block, keep them to 1/8
+	blockSize = 256;
+	while (blockSize < 16*sett.precision) blockSize *= 2;
+}
 
-			}
-		}
-	}
-	if (settings.artifactRedution) {
-		artifact_reduction();
+void FFTInterpolator::prepare() {
+	Interpolator::prepare();
+	N = blockSize;
+	while (N > staged.size()) N /= 2;
+	assert (N > buffer.size());
+	plan = FFTPlan<float>::get(N);
+	upPlan = FFTPlan<float>::get(N*settings.pointsMult);
+}
+
+void FFTInterpolator::interpolate_range(quint32 first, quint32 count) {
+	const quint32 taps = buffer.size(), mult = settings.pointsMult;
+	assert (first + count <= input->size());
+	std::vector<std::complex<float>> spectrum (N/2 + 1);
+	std::vector<std::complex<float>> padded (N*mult/2 + 1, std::complex<float> (0.f, 0.f));
+	std::vector<float> upsampled (N*mult);
+
+	// Block starting at staged sample s gives the outputs of input positions
+	// s..s+N-taps, the last block is moved back to end at the staged end
+	const quint32 valid = N - taps;
+	const quint32 offset = mult*(taps/2 - 1) + 1;
+	for (quint32 i = first, ie = first + count; i < ie; i += valid) {
+		quint32 s = std::min(i, (quint32)staged.size() - N);
+		plan->forward_real(staged.data() + s, spectrum.data());
+		// Nyquist bin is split between the positive and negative halves
+		for (quint32 k = 0; k < N/2; k++) padded[k] = spectrum[k]*(float)mult;
+		padded[N/2] = spectrum[N/2]*(0.5f*mult);
+		upPlan->inverse_real(padded.data(), upsampled.data());
+		quint32 end = std::min(i + valid, ie);
+		memcpy(output.data() + i*mult, upsampled.data() + (i - s)*mult + offset, sizeof(float)*(end - i)*mult);
 	}
-	memcpy(buffer.data(), input->data() + input->size() - buffer.size(), sizeof(float)*buffer.size());
 }
 
 void InterpolationThread::run() {
-	inter.get()->interpolate();
+	inter.get()->interpolate_range(first, count);
 }
 
 InterpolationClass::InterpolationClass() : QObject() {
@@ -110,40 +278,69 @@ InterpolationClass::~InterpolationClass() {
 }
 
 void InterpolationClass::start() {
-	if (interEnabled) {
+	if (interEnabled && !interLazy) {
 		mutex.lock();
-		bool running = false;
-		for (quint32 i = 0, ie = interpolators.size(); i < ie; i++) {
-			thisPool->start(&(interpolators[i]));
-			running = true;
+		const quint32 streams = interpolators.size();
+		const quint32 perStream = std::max<quint32> ((thisPool->maxThreadCount() + streams - 1)/streams, 1);
+		chunks.clear();
+		for (InterpolationThread& a: interpolators) {
+			a.inter.get()->prepare();
+			quint32 size = a.inter.get()->get_input()->size(), gran = a.inter.get()->get_granularity();
+			quint32 parts = std::min(perStream, std::max(size/minChunk, 1u));
+			quint32 chunk = ((size + parts - 1)/parts + gran - 1)/gran*gran;
+			for (quint32 first = 0; first < size; first += chunk)
+				chunks.push_back(InterpolationThread (a.inter, first, std::min(chunk, size - first)));
 		}
-		if (running) thisPool->waitForDone();
+		for (InterpolationThread& a: chunks) thisPool->start(&a);
+		thisPool->waitForDone();
+		for (InterpolationThread& a: interpolators) a.inter.get()->finish();
 		mutex.unlock();
 	}
 	finished();
 }
 
+std::shared_ptr<Interpolator> InterpolationClass::create(quint32 type) {
+	switch (type) {
+		case WhittakerShannon:
+			return std::shared_ptr<Interpolator> (new WhitShanInterpolator);
+		case CubicCatmullRom:
+			return std::shared_ptr<Interpolator> (new CubicInterpolator);
+		case Lanczos:
+			return std::shared_ptr<Interpolator> (new LanczosInterpolator);
+		case FFTZeroPadding:
+			return std::shared_ptr<Interpolator> (new FFTInterpolator);
+		default:
+			assert(false);
+			return std::shared_ptr<Interpolator> ();
+	}
+}
+
 void InterpolationClass::set_inter_type(quint32 type) {
 	if (type == interType || interpolators.size() == 0) return;
 	mutex.lock();
 	interType = type;
+	localCopy.reset();
 	InterpolatorSettings s (interpolators[0].inter.get()->get_settings());
 	for (quint32 i = 0, ie = interpolators.size(); i < ie; ++i) {
-		interpolators[i].inter.reset();
-		switch (type) {
-			case WhittakerShannon: {
-				std::shared_ptr<Interpolator> t (new WhitShanInterpolator);
-				t.get()->set_settings(s);
-				interpolators[i].inter = t;
-				break;
-			} default:
-				assert(false);
-				break;
-		}
+		std::vector<float> const* input = interpolators[i].inter.get()->get_input();
+		interpolators[i].inter = create(type);
+		interpolators[i].inter.get()->set_settings(s);
+		interpolators[i].inter.get()->set_input(input);
 	}
 	mutex.unlock();
 }
 
+std::shared_ptr<const Interpolator> InterpolationClass::get_local_interpolator() {
+	mutex.lock();
+	if (!localCopy) {
+		localCopy = create(interType);
+		localCopy->set_settings(interpolators[0].inter.get()->get_settings());
+	}
+	std::shared_ptr<const Interpolator> t = localCopy;
+	mutex.unlock();
+	return t;
+}
+
 void InterpolationClass::set_inputs (quint32 inputs) {
 	mutex.lock();
 	assert(inputs);
@@ -151,23 +348,14 @@ void InterpolationClass::set_inputs (quint32 inputs) {
 		interpolators.pop_back();
 	}
 	while (inputs > interpolators.size()) {
-		switch (interType) {
-			case WhittakerShannon: {
-				InterpolationThread t;
-				t.inter = std::shared_ptr<Interpolator> (new WhitShanInterpolator);
-				interpolators.push_back(t);
-				break;
-			} default:
-				assert(false);
-				break;
-		}
+		interpolators.push_back(InterpolationThread (create(interType)));
 	}
 	mutex.unlock();
 }
 
 void InterpolationClass::save_settings(std::ostream &os) const {
 	quint32 tmp = interpolators.size();
-	char t = interEnabled;
+	char t = interEnabled | (interLazy << 1) | (interType << 2);
 	os.write("INPL", 4);
 	os.write((char*)&tmp, 4);
 	os.write(&t, 1);
@@ -181,8 +369,16 @@ void InterpolationClass::load_settings(std::istream &is) {
 	char h[9];
 	is.read(h, 9);
 	if (strncmp(h, "INPL", 4) || is.fail()) throw std::runtime_error ("");
+	quint32 type = (quint8)h[8] >> 2;
+	if (type >= TotalIntTypes) throw std::runtime_error ("");
 	set_inputs(*(quint32*)(h+4));
-	set_inter_enabled(*(char*)(h+8));
+	set_inter_enabled(*(char*)(h+8) & 1);
+	set_inter_lazy(*(char*)(h+8) & 2);
+	// Interpolators save type specific settings, recreate them first
+	set_inter_type(type);
+	mutex.lock();
 	for (InterpolationThread& a: interpolators)
 		a.inter.get()->load_settings(is);
+	localCopy.reset();
+	mutex.unlock();
 }
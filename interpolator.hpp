@@ -30,6 +30,8 @@
 #include <memory>
 #include <cmath>
 #include <iostream>
+#include <complex>
+#include "fft.hpp"
 
 struct InterpolatorSettings {
 		quint32 pointsMult = 2;
@@ -41,11 +43,17 @@ class Interpolator {
 
 	protected:
 		std::vector<float> buffer;
+		std::vector<float> staged;
 		std::vector<float> output;
-		std::vector<float> const* input;
+		std::vector<float> const* input = nullptr;
 
 		InterpolatorSettings settings;
 
+		static float sinc (float delta) {
+			if (delta == 0) return 1.f;
+			return std::sin(3.14159f*delta)/(3.14159f*delta);
+		}
+
 	public:
 
 		Interpolator();
@@ -55,9 +63,30 @@ class Interpolator {
 		void artifact_reduction ();
 		void set_input (std::vector<float> const* inp)
 			{ input = inp; }
-		virtual void interpolate () = 0;
+		std::vector<float> const* get_input () const
+			{ return input; }
+		void interpolate ();
+		// interpolate() in parts: prepare() stages [history | input], then
+		// interpolate_range() over input positions [first, first + count)
+		// may run for disjoint ranges in parallel, finish() stores history
+		virtual void prepare ();
+		virtual void interpolate_range (quint32 first, quint32 count) = 0;
+		void finish ();
+		// Range boundaries at multiples of this keep the output independent
+		// of the split, valid after prepare()
+		virtual quint32 get_granularity () const
+			{ return 32; }
 		std::vector<float> const* get_output () const
 			{ return &output; }
+		// Samples of the history kept between buffers, also the kernel length
+		quint32 get_history_size () const
+			{ return buffer.size(); }
+
+		// Samples [first, first + count) of 'data' upsampled by pointsMult,
+		// sample f lies at data index f/pointsMult. Needs history_size/2 + 1
+		// samples of data around the range. Independent of the streaming
+		// state, the default is the direct Whittaker-Shannon sum.
+		virtual void interpolate_local (const float* data, quint32 first, quint32 count, float* out) const;
 
 		void save_settings (std::ostream& os) const;
 		void load_settings (std::istream& is);
@@ -65,34 +94,106 @@ class Interpolator {
 };
 
 
-class WhitShanInterpolator : public Interpolator {
+// Interpolation with a kernel of 'taps' input samples, in polyphase form: one
+// contiguous kernel per output phase, applied over a contiguous
+// [history | input] staging buffer. Output sample i*pointsMult + q lies
+// taps/2 - 1 + (q + 1)/pointsMult samples after staged sample i.
 
-		std::vector<float> sinc_tab;
+class PolyphaseInterpolator : public Interpolator {
 
-		float sinc (float delta) {
-			if (delta == 0) return 1.f;
-			return std::sin(3.14159f*delta)/(3.14159f*delta);
-		}
+		std::vector<float> phases;
 
-		void tabulate_sinc ();
+		void tabulate_phases ();
+
+	protected:
+		virtual quint32 get_taps () const
+			{ return 2*settings.precision; }
+		virtual float kernel (float delta) const = 0;
+
+	public:
+		void set_settings (InterpolatorSettings sett);
+		void interpolate_range (quint32 first, quint32 count);
+		void interpolate_local (const float* data, quint32 first, quint32 count, float* out) const;
+
+};
+
+class WhitShanInterpolator : public PolyphaseInterpolator {
+
+	protected:
+		float kernel (float delta) const
+			{ return sinc(delta); }
 
 	public:
 		WhitShanInterpolator();
-		void set_settings(InterpolatorSettings sett);
-		void interpolate ();
 
 };
 
+// Catmull-Rom cubic, 4 taps regardless of precision
+
+class CubicInterpolator : public PolyphaseInterpolator {
+
+	protected:
+		quint32 get_taps () const
+			{ return 4; }
+		float kernel (float delta) const;
+
+	public:
+		CubicInterpolator();
+
+};
+
+// Sinc windowed by the Lanczos window, a = precision
+
+class LanczosInterpolator : public PolyphaseInterpolator {
+
+	protected:
+		float kernel (float delta) const;
+
+	public:
+		LanczosInterpolator();
+
+};
+
+// Band limited interpolation by zero padding the spectrum of overlapping
+// blocks. Each block keeps 'precision' samples of guard on both sides, the
+// output timing is the same as of the polyphase interpolators.
+
+class FFTInterpolator : public Interpolator {
+
+		std::shared_ptr<const FFTPlan<float>> plan;
+		std::shared_ptr<const FFTPlan<float>> upPlan;
+		quint32 blockSize = 0;
+		quint32 N = 0;
+
+	public:
+		FFTInterpolator();
+		void set_settings (InterpolatorSettings sett);
+		void prepare ();
+		void interpolate_range (quint32 first, quint32 count);
+		// Whole blocks
+		quint32 get_granularity () const
+			{ return N - buffer.size(); }
+
+};
+
+
+// Interpolates input positions [first, first + count) of 'inter'
 
 class InterpolationThread : public QRunnable {
 
 	public:
 		std::shared_ptr<Interpolator> inter;
+		quint32 first = 0;
+		quint32 count = 0;
 
 		InterpolationThread () : QRunnable() {
 			setAutoDelete(false);
 			inter = std::shared_ptr<Interpolator> (new WhitShanInterpolator());
 		}
+		InterpolationThread (std::shared_ptr<Interpolator> _inter, quint32 _first = 0, quint32 _count = 0) :
+			QRunnable(), inter(_inter), first(_first), count(_count) {
+			setAutoDelete(false);
+		}
 		virtual ~InterpolationThread() {}
 		void run();
 
@@ -105,11 +206,21 @@ class InterpolationClass : public QObject {
 
 
 		std::vector<InterpolationThread> interpolators;
+		// Parts of the streams interpolated in parallel, a stream is split in
+		// up to one chunk per pool thread of at least minChunk input samples
+		std::vector<InterpolationThread> chunks;
+		static const quint32 minChunk = 1024;
 		quint32 interType = WhittakerShannon;
 		bool interEnabled = false;
+		bool interLazy = false;
 		std::shared_ptr<QThreadPool> thisPool;
 		QMutex mutex;
+		// Copy handed to the pulse processing in lazy mode, replaced rather
+		// than changed when the settings change, so it is never written
+		// while being read
+		std::shared_ptr<Interpolator> localCopy;
 
+		static std::shared_ptr<Interpolator> create (quint32 type);
 
 	public:
 
@@ -119,11 +230,15 @@ class InterpolationClass : public QObject {
 			{ mutex.lock(); interpolators[stream].inter.get()->set_input(input); mutex.unlock(); }
 		std::vector<float> const* get_output (quint32 stream) const
 			{ return interpolators[stream].inter.get()->get_output(); }
+		std::shared_ptr<const Interpolator> get_interpolator (quint32 stream) const
+			{ return interpolators[stream].inter; }
+		std::shared_ptr<const Interpolator> get_local_interpolator ();
 		void set_inputs (quint32 inputs);
 		quint32 get_inputs () const { return interpolators.size(); }
 		void set_settings (InterpolatorSettings set)
 			{ mutex.lock();
 			  for(quint32 stream = 0, ie = interpolators.size(); stream < ie; stream++) interpolators[stream].inter.get()->set_settings(set);
+			  localCopy.reset();
 			  mutex.unlock(); }
 		InterpolatorSettings get_settings () const
 			{ return interpolators[0].inter.get()->get_settings(); }
@@ -132,6 +247,11 @@ class InterpolationClass : public QObject {
 			{ mutex.lock(); interEnabled = val; mutex.unlock(); }
 		bool get_inter_enabled() const
 			{ return interEnabled; }
+		// Only pulse windows are interpolated, by the pulse processing
+		void set_inter_lazy (bool val)
+			{ mutex.lock(); interLazy = val; mutex.unlock(); }
+		bool get_inter_lazy () const
+			{ return interLazy; }
 		quint32 get_inter_type () const
 			{ return interType; }
 		void save_settings (std::ostream& os) const;
@@ -139,6 +259,9 @@ class InterpolationClass : public QObject {
 
 		enum Interpolators {
 			WhittakerShannon = 0,
+			CubicCatmullRom,
+			Lanczos,
+			FFTZeroPadding,
 			TotalIntTypes
 		};
 
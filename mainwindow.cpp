@@ -83,6 +83,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 	rightDockGraphicsSelectCB = new QComboBox (rightDockWidChild);
 	rightDockGraphicsSelectCB->addItem(tr("Spectrum"), QVariant((quint32)Spectrum));
 	rightDockGraphicsSelectCB->addItem(tr("Signal"), QVariant((quint32)Signal));
+	rightDockGraphicsSelectCB->addItem(tr("Noise spectrum"), QVariant((quint32)NoiseSpectrum));
 	rightDockXLogLabel = new QLabel (tr("Use logarithm X axis"), rightDockWidChild);
 	rightDockXLogCB = new QCheckBox (rightDockWidChild);
 	rightDockYLogLabel = new QLabel (tr("Use logarithm Y axis"), rightDockWidChild);
@@ -93,13 +94,15 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 	rightDockGraphName = new QLabel (tr("Stream"), rightDockWidChild);
 	rightDockGraphColor = new QLabel (tr("Color"), rightDockWidChild);
 	rightDockGraphEnable = new QLabel (tr("Show"), rightDockWidChild);
-	graphicsColorsVec.resize(2);
+	graphicsColorsVec.resize(3);
 	graphicsColorsVec[0].push_back(Qt::blue);
 	graphicsColorsVec[0].push_back(Qt::black);
 	graphicsColorsVec[0].push_back(Qt::red);
 	graphicsColorsVec[1].push_back(Qt::blue);
 	graphicsColorsVec[1].push_back(Qt::black);
 	graphicsColorsVec[1].push_back(Qt::red);
+	graphicsColorsVec[2].push_back(Qt::blue);
+	graphicsColorsVec[2].push_back(Qt::red);
 	rightDockSmoothingDSB->setMaximum(1.);
 	rightDockSmoothingDSB->setMinimum(0.);
 	rightDockSmoothingDSB->setDecimals(2);
@@ -331,6 +334,34 @@ void MainWindow::graphics_update_slot(bool check) {
 			}
 			graphicsPlot->replot();
 			break;
+		} case NoiseSpectrum: {
+			double min(0.), max(0.), maxFreq(0.), minFreq(0.);
+			for (quint32 n = 0; n < CoreClass->get_input_streams(); n++) {
+				for (quint32 s = 0; s < NoiseMonitor::TotalStages; s++) {
+					quint32 total = n*NoiseMonitor::TotalStages + s;
+					std::vector<float> psd = CoreClass->get_noise_psd(n, s);
+					double rate = s == NoiseMonitor::Raw ? CoreClass->get_sample_rate() : CoreClass->get_effective_sample_rate(n);
+					// DC bin is dropped, it holds only the removed segment mean
+					QVector<double> freq (psd.size() > 1 ? psd.size() - 1 : 0);
+					QVector<double> density (freq.size());
+					for (qint32 k = 0; k < freq.size(); ++k) {
+						freq[k] = (k + 1)*rate/(2*freq.size());
+						density[k] = psd[k + 1]/rate;
+					}
+					graphicsPlot->graph(total)->setData(freq, density);
+					if (freq.empty() || rightDockGraphEnableCBs[total]->checkState() != Qt::Checked) continue;
+					if (maxFreq < freq.back()) maxFreq = freq.back();
+					if (minFreq == 0. || minFreq > freq.front()) minFreq = freq.front();
+					for (qint32 k = 0; k < density.size(); ++k) {
+						if (max < density[k]) max = density[k];
+						if (density[k] > 0. && (min == 0. || min > density[k])) min = density[k];
+					}
+				}
+			}
+			graphicsPlot->xAxis->setRange(rightDockXLogCB->checkState() == Qt::Checked ? minFreq : 0., maxFreq);
+			graphicsPlot->yAxis->setRange(rightDockYLogCB->checkState() == Qt::Checked ? min : 0., max);
+			graphicsPlot->replot();
+			break;
 		} default:
 			assert(false);
 			break;
@@ -421,6 +452,55 @@ void MainWindow::graphic_view_update_slot() {
 			//graphicsPlot->xAxis->setTicker(a);
 			//graphicsPlot->yAxis->setTicker(b);
 			break;
+		} case NoiseSpectrum: {
+			graphicsPlot->clearGraphs();
+			graphicsPlot->xAxis->setLabel(tr("Frequency, Hz"));
+			graphicsPlot->yAxis->setLabel(tr("Noise density, 1/Hz"));
+			const quint32 count = CoreClass->get_input_streams()*NoiseMonitor::TotalStages;
+			if (graphicsColorsVec[2].size() < count) {
+				std::uniform_int_distribution<quint32> dist (0, 255);
+				std::default_random_engine gen;
+				gen.seed(std::time(0));
+				while (graphicsColorsVec[2].size() < count) {
+					QColor col;
+					col.setBlue(dist(gen));
+					col.setRed(dist(gen));
+					col.setGreen(dist(gen));
+					col.setAlpha(dist(gen));
+					graphicsColorsVec[2].push_back(col);
+				}
+			}
+			for (quint32 n = 0; n < count; n++) {
+				graphicsPlot->addGraph();
+				pen.setColor(graphicsColorsVec[2][n]);
+				graphicsPlot->graph(n)->setPen(pen);
+			}
+			graphics_info_update(count);
+			for (quint32 n = 0; n < count; n++) {
+				QString name = CoreClass->get_input_name(n/NoiseMonitor::TotalStages);
+				name += n%NoiseMonitor::TotalStages == NoiseMonitor::Raw ? tr(" raw") : tr(" filtered");
+				graphicsPlot->graph(n)->setName(name);
+				rightDockGraphColorLabels[n]->setText(name);
+			}
+			rightDockXLogLabel->show();
+			rightDockXLogCB->show();
+			rightDockYLogLabel->show();
+			rightDockYLogCB->show();
+			rightDockSmoothingDSB->hide();
+			rightDockSmoothingLabel->hide();
+			if (rightDockXLogCB->checkState() == Qt::Checked) {
+				graphicsPlot->xAxis->setScaleType(QCPAxis::stLogarithmic);
+			}
+			else {
+				graphicsPlot->xAxis->setScaleType(QCPAxis::stLinear);
+			}
+			if (rightDockYLogCB->checkState() == Qt::Checked) {
+				graphicsPlot->yAxis->setScaleType(QCPAxis::stLogarithmic);
+			}
+			else {
+				graphicsPlot->yAxis->setScaleType(QCPAxis::stLinear);
+			}
+			break;
 		} default:
 			throw std::invalid_argument ("Error! Invalid graphic mode index.\n");
 			break;
@@ -108,7 +108,8 @@ class MainWindow : public QMainWindow {
 
 		enum GraphicView {
 			Spectrum,
-			Signal
+			Signal,
+			NoiseSpectrum
 		};
 
 		void graphics_info_update(quint32 newCount);
@@ -0,0 +1,250 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "minibatchtrainer.hpp"
+#include "activation.hpp"
+#include <algorithm>
+#include <numeric>
+
+namespace Neural_Network {
+
+// Samples per block of the error evaluation, bounds the layer output buffers
+static const quint32 ErrorBlock = 0x4000;
+
+MinibatchTrainer::MinibatchTrainer(const Perceptron &_percep) {
+	assert(!_percep.is_empty());
+	thisPool = std::shared_ptr<QThreadPool> (new QThreadPool);
+	inputsNum = _percep.inputs();
+	outputsNum = _percep.outputs();
+	outputWeights.setOnes(outputsNum);
+	layersVec.resize(_percep.layers());
+	for (quint32 l = 0; l < _percep.layers(); ++l) {
+		Layer& layer = layersVec[l];
+		const quint32 neurons = _percep.neurons(l);
+		const quint32 weights = l ? _percep.neurons(l-1) : inputsNum;
+		layer.weights.resize(neurons, weights);
+		layer.bias.resize(neurons);
+		layer.activation.resize(neurons);
+		for (quint32 n = 0; n < neurons; ++n) {
+			assert(_percep.weights(l, n) == weights);
+			layer.weights.row(n) = Eigen::Map<const Eigen::RowVectorXf> (_percep.get_weights(l, n).data(), weights);
+			layer.bias[n] = _percep.get_const(l, n);
+			layer.activation[n] = _percep.get_func_id(l, n);
+		}
+		if (std::count(layer.activation.begin(), layer.activation.end(), layer.activation[0]) == (qint32)neurons)
+			layer.activation.resize(1);
+		layer.weightsMoment.setZero(neurons, weights);
+		layer.biasMoment.setZero(neurons);
+		layer.weightsSquare.setZero(neurons, weights);
+		layer.biasSquare.setZero(neurons);
+	}
+}
+
+void MinibatchTrainer::store(Perceptron &_percep) const {
+	assert(_percep.layers() == layersVec.size() && _percep.inputs() == inputsNum);
+	for (quint32 l = 0; l < layersVec.size(); ++l) {
+		const Layer& layer = layersVec[l];
+		std::vector<float> weights (layer.weights.cols());
+		for (quint32 n = 0; n < layer.weights.rows(); ++n) {
+			Eigen::Map<Eigen::RowVectorXf> (weights.data(), weights.size()) = layer.weights.row(n);
+			_percep.set_weight(weights, l, n);
+			_percep.set_const(layer.bias[n], l, n);
+		}
+	}
+}
+
+void MinibatchTrainer::set_data(const float *_inputs, const float *_targets, quint32 _samples) {
+	inputData = _inputs;
+	targetData = _targets;
+	samples = _samples;
+	order.resize(samples);
+	std::iota(order.begin(), order.end(), 0);
+}
+
+void MinibatchTrainer::set_output_weights(const std::vector<float> &_weights) {
+	assert(_weights.size() == outputsNum);
+	outputWeights = Eigen::Map<const Eigen::VectorXf> (_weights.data(), outputsNum);
+}
+
+void MinibatchTrainer::set_optimizer(Optimizer _opt) {
+	optimizer = _opt;
+	steps = 0;
+	for (Layer& layer: layersVec) {
+		layer.weightsMoment.setZero();
+		layer.biasMoment.setZero();
+		layer.weightsSquare.setZero();
+		layer.biasSquare.setZero();
+	}
+}
+
+bool MinibatchTrainer::is_zero() const {
+	for (const Layer& layer: layersVec) if (!layer.weights.isZero(0.f) || !layer.bias.isZero(0.f)) return false;
+	return true;
+}
+
+void MinibatchTrainer::randomize(std::default_random_engine &_generator) {
+	for (Layer& layer: layersVec) {
+		std::uniform_real_distribution<float> weightGet (-1.f, 1.f);
+		const float range = std::sqrt(6.f/(layer.weights.rows() + layer.weights.cols()));
+		for (qint32 i = 0; i < layer.weights.size(); ++i) layer.weights.data()[i] = range*weightGet(_generator);
+		layer.bias.setZero();
+	}
+}
+
+void MinibatchTrainer::shuffle(std::default_random_engine &_generator) {
+	std::shuffle(order.begin(), order.end(), _generator);
+}
+
+// '_out' holds whole samples, element i belongs to neuron i % rows
+void MinibatchTrainer::activate(quint32 _layer, Eigen::MatrixXf &_out) const {
+	const std::vector<quint32>& act = layersVec[_layer].activation;
+	if (act.size() == 1) Neural_Network::activate(act[0], _out.data(), _out.size());
+	else for (qint32 i = 0, rows = _out.rows(); i < _out.size(); ++i) _out.data()[i] = activation_value(act[i % rows], _out.data()[i]);
+}
+
+void MinibatchTrainer::forward(Shard &_shard) const {
+	Eigen::Map<const Eigen::MatrixXf> in (_shard.input, inputsNum, _shard.count);
+	_shard.out.resize(layersVec.size());
+	for (quint32 l = 0; l < layersVec.size(); ++l) {
+		Eigen::MatrixXf& out = _shard.out[l];
+		if (l) out.noalias() = layersVec[l].weights * _shard.out[l-1];
+		else out.noalias() = layersVec[l].weights * in;
+		out.colwise() += layersVec[l].bias;
+		activate(l, out);
+	}
+}
+
+// Expects the weighted output error (target - output) in the last delta and
+// leaves the descent direction, summed over the shard, in the gradients
+void MinibatchTrainer::backward(Shard &_shard) const {
+	Eigen::Map<const Eigen::MatrixXf> in (_shard.input, inputsNum, _shard.count);
+	_shard.weightsGrad.resize(layersVec.size());
+	_shard.biasGrad.resize(layersVec.size());
+	for (qint32 l = layersVec.size() - 1; l >= 0; --l) {
+		const std::vector<quint32>& act = layersVec[l].activation;
+		const Eigen::MatrixXf& out = _shard.out[l];
+		Eigen::MatrixXf& delta = _shard.delta[l];
+		if (act.size() == 1) switch (act[0]) {
+			case SIGMOID_ID: delta.array() *= out.array()*(out.array() - 1.f); break;
+			case HIPERBOLIC_TAN_ID: delta.array() *= 1.f - out.array().square(); break;
+			default: break;
+		} else for (qint32 i = 0, rows = out.rows(); i < out.size(); ++i) delta.data()[i] *= activation_diff(act[i % rows], out.data()[i]);
+		if (l) _shard.weightsGrad[l].noalias() = delta * _shard.out[l-1].transpose();
+		else _shard.weightsGrad[l].noalias() = delta * in.transpose();
+		_shard.biasGrad[l] = delta.rowwise().sum();
+		if (l) _shard.delta[l-1].noalias() = layersVec[l].weights.transpose() * delta;
+	}
+}
+
+void MinibatchTrainer::Shard::run() {
+	trainer->forward(*this);
+	Eigen::Map<const Eigen::MatrixXf> targets (target, trainer->outputsNum, count);
+	delta.resize(trainer->layersVec.size());
+	Eigen::MatrixXf& err = delta.back();
+	err = targets - out.back();
+	error = (err.array().square().colwise() * trainer->outputWeights.array()).sum();
+	if (backward) {
+		err.array().colwise() *= trainer->outputWeights.array();
+		trainer->backward(*this);
+	}
+}
+
+quint32 MinibatchTrainer::run_shards(const float *_input, const float *_target, quint32 _count, bool _backward) {
+	const quint32 parts = std::max<quint32> (std::min<quint32> (thisPool->maxThreadCount(), _count/minShard), 1);
+	const quint32 chunk = (_count + parts - 1)/parts;
+	if (shards.size() < parts) shards.resize(parts);
+	for (quint32 i = 0; i < parts; ++i) {
+		Shard& shard = shards[i];
+		const quint32 first = std::min(i*chunk, _count);
+		shard.trainer = this;
+		shard.input = _input + (size_t)first*inputsNum;
+		shard.target = _target + (size_t)first*outputsNum;
+		shard.count = std::min(chunk, _count - first);
+		shard.backward = _backward;
+	}
+	if (parts == 1) shards[0].run();
+	else {
+		for (quint32 i = 0; i < parts; ++i) thisPool->start(&shards[i]);
+		thisPool->waitForDone();
+	}
+	return parts;
+}
+
+void MinibatchTrainer::step(quint32 _shards, quint32 _count) {
+	const float norm = 1.f/_count;
+	// 'momentum' doubles as the first moment decay of Adam
+	const float beta1 = momentum;
+	float adamRate = learningRate;
+	if (optimizer == AdamOptimizer) {
+		++steps;
+		adamRate *= std::sqrt(1.f - std::pow(adamBeta2, (float)steps))/(1.f - std::pow(beta1, (float)steps));
+	}
+	for (quint32 l = 0; l < layersVec.size(); ++l) {
+		Layer& layer = layersVec[l];
+		Eigen::MatrixXf& weightsGrad = shards[0].weightsGrad[l];
+		Eigen::VectorXf& biasGrad = shards[0].biasGrad[l];
+		for (quint32 i = 1; i < _shards; ++i) {
+			weightsGrad += shards[i].weightsGrad[l];
+			biasGrad += shards[i].biasGrad[l];
+		}
+		weightsGrad *= norm;
+		biasGrad *= norm;
+		if (optimizer == MomentumOptimizer) {
+			layer.weightsMoment = momentum*layer.weightsMoment + learningRate*weightsGrad;
+			layer.biasMoment = momentum*layer.biasMoment + learningRate*biasGrad;
+			layer.weights += layer.weightsMoment;
+			layer.bias += layer.biasMoment;
+		} else {
+			layer.weightsMoment = beta1*layer.weightsMoment + (1.f - beta1)*weightsGrad;
+			layer.biasMoment = beta1*layer.biasMoment + (1.f - beta1)*biasGrad;
+			layer.weightsSquare = adamBeta2*layer.weightsSquare + (1.f - adamBeta2)*weightsGrad.cwiseAbs2();
+			layer.biasSquare = adamBeta2*layer.biasSquare + (1.f - adamBeta2)*biasGrad.cwiseAbs2();
+			layer.weights.array() += adamRate*layer.weightsMoment.array()/(layer.weightsSquare.array().sqrt() + adamEpsilon);
+			layer.bias.array() += adamRate*layer.biasMoment.array()/(layer.biasSquare.array().sqrt() + adamEpsilon);
+		}
+	}
+}
+
+void MinibatchTrainer::train_batch(quint32 _index) {
+	assert(_index < batches());
+	const quint32 first = _index*batchSize;
+	const quint32 count = std::min(batchSize, samples - first);
+	batchInput.resize(inputsNum, count);
+	batchTarget.resize(outputsNum, count);
+	for (quint32 i = 0; i < count; ++i) {
+		const size_t sample = order[first + i];
+		memcpy(batchInput.col(i).data(), inputData + sample*inputsNum, 4*inputsNum);
+		memcpy(batchTarget.col(i).data(), targetData + sample*outputsNum, 4*outputsNum);
+	}
+	step(run_shards(batchInput.data(), batchTarget.data(), count, true), count);
+}
+
+double MinibatchTrainer::get_error() {
+	double dtmp (.0);
+	for (quint32 first = 0; first < samples; first += ErrorBlock) {
+		const quint32 count = std::min(ErrorBlock, samples - first);
+		const quint32 parts = run_shards(inputData + (size_t)first*inputsNum, targetData + (size_t)first*outputsNum, count, false);
+		for (quint32 i = 0; i < parts; ++i) dtmp += shards[i].error;
+	}
+	return std::sqrt(dtmp/samples);
+}
+
+}
@@ -0,0 +1,140 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef MINIBATCHTRAINER_HPP
+#define MINIBATCHTRAINER_HPP
+
+#include "perceptron.hpp"
+#include "Eigen/Core"
+#include <QThreadPool>
+#include <QRunnable>
+#include <random>
+#include <memory>
+
+namespace Neural_Network {
+
+// Gradient trainer working on flat copies of the Perceptron weights. Samples
+// are contiguous columns (inputs, then targets) and every minibatch is split
+// into shards, each running the forward and backward passes as one GEMM per
+// layer on its own pool thread. Shard gradients are summed and applied by an
+// SGD-momentum or Adam step. The loss is the one TeachingClass minimises:
+// squared output error scaled by the per-output teaching weights.
+
+class MinibatchTrainer {
+
+	public:
+
+		enum Optimizer {
+			MomentumOptimizer = 0,
+			AdamOptimizer
+		};
+
+	private:
+
+		struct Layer {
+			Eigen::MatrixXf weights;
+			Eigen::VectorXf bias;
+			std::vector<quint32> activation;
+			Eigen::MatrixXf weightsMoment;
+			Eigen::VectorXf biasMoment;
+			Eigen::MatrixXf weightsSquare;
+			Eigen::VectorXf biasSquare;
+		};
+
+		class Shard : public QRunnable {
+			public:
+				MinibatchTrainer* trainer = nullptr;
+				const float* input = nullptr;
+				const float* target = nullptr;
+				quint32 count = 0;
+				bool backward = true;
+				double error = 0.;
+				std::vector<Eigen::MatrixXf> out;
+				std::vector<Eigen::MatrixXf> delta;
+				std::vector<Eigen::MatrixXf> weightsGrad;
+				std::vector<Eigen::VectorXf> biasGrad;
+
+				Shard() : QRunnable() { setAutoDelete(false); }
+				Shard(const Shard& _shard) : QRunnable(), trainer(_shard.trainer) { setAutoDelete(false); }
+				virtual ~Shard() {}
+				void run();
+		};
+
+		std::vector<Layer> layersVec;
+		std::vector<Shard> shards;
+		std::shared_ptr<QThreadPool> thisPool;
+		quint32 inputsNum = 0;
+		quint32 outputsNum = 0;
+		Eigen::VectorXf outputWeights;
+
+		const float* inputData = nullptr;
+		const float* targetData = nullptr;
+		quint32 samples = 0;
+		std::vector<quint32> order;
+		Eigen::MatrixXf batchInput;
+		Eigen::MatrixXf batchTarget;
+
+		Optimizer optimizer = AdamOptimizer;
+		quint32 batchSize = 256;
+		quint32 minShard = 64;
+		quint32 steps = 0;
+		float learningRate = 3e-3f;
+		float momentum = .9f;
+		float adamBeta2 = .999f;
+		float adamEpsilon = 1e-8f;
+
+		void activate (quint32 _layer, Eigen::MatrixXf& _out) const;
+		void forward (Shard& _shard) const;
+		void backward (Shard& _shard) const;
+		quint32 run_shards (const float* _input, const float* _target, quint32 _count, bool _backward);
+		void step (quint32 _shards, quint32 _count);
+
+	public:
+
+		explicit MinibatchTrainer (const Perceptron& _percep);
+		void store (Perceptron& _percep) const;
+		// '_inputs' holds inputs() floats per sample, '_targets' outputs() floats per sample
+		void set_data (const float* _inputs, const float* _targets, quint32 _samples);
+		void set_output_weights (const std::vector<float>& _weights);
+		void set_optimizer (Optimizer _opt);
+		void set_learning_rate (float _rate) { learningRate = _rate; }
+		void set_momentum (float _momentum) { momentum = _momentum; }
+		void set_batch_size (quint32 _size) { assert(_size); batchSize = _size; }
+		void set_threads (quint32 _threads) { thisPool->setMaxThreadCount(_threads); }
+		static float default_learning_rate (Optimizer _opt) { return _opt == AdamOptimizer ? 3e-3f : 1.f; }
+
+		quint32 inputs () const { return inputsNum; }
+		quint32 outputs () const { return outputsNum; }
+		quint32 batches () const { return (samples + batchSize - 1)/batchSize; }
+		// A fresh net has all weights at zero, gradient descent cannot break that
+		// symmetry, so such a net gets small random weights first
+		bool is_zero () const;
+		void randomize (std::default_random_engine& _generator);
+		// Draws a new sample order for the following batches
+		void shuffle (std::default_random_engine& _generator);
+		void train_batch (quint32 _index);
+		// Weighted RMS error over the whole data set, same measure as TeachingClass
+		double get_error ();
+};
+
+}
+
+#endif // MINIBATCHTRAINER_HPP
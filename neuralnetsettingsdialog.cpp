@@ -109,6 +109,12 @@ NeuralNetSettingsDialog::NeuralNetSettingsDialog(Core* _corePtr, QWidget* _paren
 	teachCyclesSB->setMinimum(1);
 	teachCyclesSB->setMaximum(50);
 
+	teachAlgorithmLabel = new QLabel (tr("Algorithm:"), teachTabWidget);
+	teachAlgorithmCB = new QComboBox (teachTabWidget);
+	teachAlgorithmCB->addItem(tr("Annealing"),				QVariant((quint32)Neural_Network::HeatImitationTeaching));
+	teachAlgorithmCB->addItem(tr("Minibatch, Adam"),		QVariant((quint32)Neural_Network::MinibatchAdamTeaching));
+	teachAlgorithmCB->addItem(tr("Minibatch, momentum"),	QVariant((quint32)Neural_Network::MinibatchMomentumTeaching));
+
 	teachSizeLabel = new QLabel (tr("Teaching size"), teachTabWidget);
 	teachSizeCB = new QComboBox (teachTabWidget);
 	teachSizeCB->addItem("4k",	QVariant((quint32)0x1000));
@@ -136,6 +142,8 @@ NeuralNetSettingsDialog::NeuralNetSettingsDialog(Core* _corePtr, QWidget* _paren
 	teachLayout->addWidget(noizeSettingsPB, ++rowIndex, 0, 1, 2);
 	teachLayout->addWidget(teachCyclesLabel, ++rowIndex, 0);
 	teachLayout->addWidget(teachCyclesSB, rowIndex, 1);
+	teachLayout->addWidget(teachAlgorithmLabel, ++rowIndex, 0);
+	teachLayout->addWidget(teachAlgorithmCB, rowIndex, 1);
 	teachLayout->addWidget(teachSizeLabel, ++rowIndex, 0);
 	teachLayout->addWidget(teachSizeCB, rowIndex, 1);
 	teachLayout->addWidget(pulShapeL, ++rowIndex, 0);
@@ -442,6 +450,7 @@ void NeuralNetSettingsDialog::startTeaching() {
 	}
 
 	currTeach->total_iterations(teachCyclesSB->value());
+	currTeach->teaching_algorithm(teachAlgorithmCB->currentData().toUInt());
 
 	currTeach->set_teaching_outputs(1);
 	NuclearPercep->set_function(functionCB->currentData().toUInt(), 0);
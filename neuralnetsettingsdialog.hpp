@@ -78,6 +78,8 @@ class NeuralNetSettingsDialog : public QDialog {
 		QPushButton* noizeSettingsPB;
 		QLabel* teachCyclesLabel;
 		QSpinBox* teachCyclesSB;
+		QLabel* teachAlgorithmLabel;
+		QComboBox* teachAlgorithmCB;
 		QLabel* teachSizeLabel;
 		QComboBox* teachSizeCB;
 		QLabel* pulShapeL;
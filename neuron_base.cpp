@@ -23,15 +23,10 @@
 
 using namespace Neural_Network;
 
-Sigmoid sigmoid;
-Linear linear;
-Hiperbolic_Tan hip_tan;
-
 neuron_base::neuron_base(quint32 _inputs) {
 	assert (_inputs);
 	inputData.resize (_inputs);
 	weights.resize (_inputs);
-	actfunc = &sigmoid;
 }
 
 neuron_base::neuron_base(const std::vector<float> &_weights) {
@@ -43,13 +38,9 @@ neuron_base::neuron_base(const std::vector<float> &_weights) {
 void neuron_base::set_activation_function(quint32 id) {
 	switch (id) {
 		case SIGMOID_ID:
-			set_activation_function(&sigmoid);
-			break;
 		case LINEAR_ID:
-			set_activation_function(&linear);
-			break;
 		case HIPERBOLIC_TAN_ID:
-			set_activation_function(&hip_tan);
+			actID = id;
 			break;
 		default:
 			break;
@@ -64,5 +55,5 @@ void neuron_base::set_weight(const std::vector<float> &_weights) {
 void neuron_base::calculate() {
 	float ftmp (constWeight);
 	for (quint32 i = 0, iend = inputData.size(); i < iend; i++) ftmp += (*(inputData[i])) * weights[i];
-	outputData = (*actfunc)(ftmp);
+	outputData = activation_value(actID, ftmp);
 }
@@ -0,0 +1,138 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "noisemonitor.hpp"
+#include <QThread>
+#include <QMutexLocker>
+#include <cmath>
+
+NoiseMonitor::NoiseMonitor() {
+	pool.setMaxThreadCount(1);
+}
+
+NoiseMonitor::~NoiseMonitor() {
+	pool.waitForDone();
+}
+
+void NoiseMonitor::set_streams (quint32 streams) {
+	pool.waitForDone();
+	estimators.clear();
+	for (quint32 i = 0; i < streams*TotalStages; i++) {
+		estimators.push_back(std::unique_ptr<Estimator> (new Estimator (this)));
+		estimators.back()->stream = i/TotalStages;
+		estimators.back()->stage = i%TotalStages;
+	}
+	QMutexLocker locker (&mutex);
+	psd.assign(streams*TotalStages, std::vector<float>());
+}
+
+void NoiseMonitor::set_segment_size (quint32 size) {
+	assert (size >= 64 && (size & (size - 1)) == 0);
+	pool.waitForDone();
+	segmentSize = size;
+	reset();
+}
+
+void NoiseMonitor::set_averages (quint32 count) {
+	averages = count ? count : 1;
+}
+
+void NoiseMonitor::reset () {
+	pool.waitForDone();
+	for (auto& a: estimators) a->reset();
+	QMutexLocker locker (&mutex);
+	for (auto& a: psd) a.clear();
+}
+
+void NoiseMonitor::feed (std::vector<std::vector<float> const*> const& raw, std::vector<std::vector<float> const*> const& filtered) {
+	if (!enabled || estimators.empty()) return;
+	if (++counter < interval) return;
+	counter = 0;
+	// Previous buffer is still being analysed, skip this one
+	if (pool.activeThreadCount()) return;
+	for (auto& a: estimators) {
+		if (a->stream >= raw.size() || a->stream >= filtered.size()) continue;
+		std::vector<float> const* input = a->stage == Raw ? raw[a->stream] : filtered[a->stream];
+		if (input == nullptr) continue;
+		a->set_data(input);
+		pool.start(a.get(), QThread::LowestPriority);
+	}
+}
+
+std::vector<float> NoiseMonitor::get_psd (quint32 stream, quint32 stage) const {
+	assert (stage < TotalStages);
+	QMutexLocker locker (&mutex);
+	if (stream*TotalStages + stage >= psd.size()) return std::vector<float>();
+	return psd[stream*TotalStages + stage];
+}
+
+void NoiseMonitor::publish (quint32 stream, quint32 stage, std::vector<double> const& average) {
+	QMutexLocker locker (&mutex);
+	if (stream*TotalStages + stage >= psd.size()) return;
+	std::vector<float>& out = psd[stream*TotalStages + stage];
+	out.resize(average.size());
+	for (quint32 i = 0; i < average.size(); i++) out[i] = average[i];
+}
+
+void NoiseMonitor::Estimator::run() {
+	QThread::currentThread()->setPriority(QThread::LowestPriority);
+	quint32 N = monitor->segmentSize;
+	while (N > data.size()) N /= 2;
+	if (N < 64) return;
+	const quint32 hop = N/2;
+	const quint32 count = (data.size() - N)/hop + 1;
+	const quint32 bins = N/2 + 1;
+	if (average.size() != bins) {
+		average.assign(bins, 0.);
+		updates = 0;
+	}
+
+	// Hann windowed segments with 50% overlap and their own mean removed
+	frames.resize(count*N);
+	spectra.resize(count*bins);
+	double wPower = 0.;
+	for (quint32 n = 0; n < N; n++) {
+		double w = 0.5 - 0.5*std::cos(2.*PI*n/N);
+		wPower += w*w;
+	}
+	for (quint32 c = 0; c < count; c++) {
+		const float* x = data.data() + c*hop;
+		float* f = frames.data() + c*N;
+		double mean = 0.;
+		for (quint32 n = 0; n < N; n++) mean += x[n];
+		mean /= N;
+		for (quint32 n = 0; n < N; n++) f[n] = (x[n] - mean)*(0.5 - 0.5*std::cos(2.*PI*n/N));
+	}
+	FFTPlan<float>::get(N)->forward_real(frames.data(), spectra.data(), count);
+
+	// One sided density for unit sample rate, averaged over the segments of
+	// the buffer and then exponentially over the analysed buffers
+	updates = std::min(updates + 1, monitor->averages);
+	const double alpha = 1./updates;
+	const double scale = 1./(wPower*count);
+	for (quint32 k = 0; k < bins; k++) {
+		double sum = 0.;
+		for (quint32 c = 0; c < count; c++) sum += std::norm(spectra[c*bins + k]);
+		sum *= (k == 0 || k == bins - 1) ? scale : 2.*scale;
+		average[k] += alpha*(sum - average[k]);
+	}
+	monitor->publish(stream, stage, average);
+}
@@ -0,0 +1,113 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef NOISEMONITOR_HPP
+#define NOISEMONITOR_HPP
+
+#include <QtGlobal>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <cassert>
+#include <memory>
+#include <vector>
+#include "fft.hpp"
+
+// Background Welch estimate of the noise power spectral density of the raw
+// and filtered data of every input. Only one buffer in 'interval' is copied
+// and analysed, on a single low priority thread; a buffer arriving while the
+// previous one is still analysed is skipped.
+
+class NoiseMonitor {
+
+		class Estimator : public QRunnable {
+				NoiseMonitor* monitor;
+				std::vector<float> data;
+				std::vector<float> frames;
+				std::vector<std::complex<float>> spectra;
+				std::vector<double> average;
+				quint32 updates = 0;
+
+			public:
+				quint32 stream = 0;
+				quint32 stage = 0;
+
+				Estimator (NoiseMonitor* _monitor) : monitor(_monitor) { setAutoDelete(false); }
+				void set_data (std::vector<float> const* input)
+					{ data.assign(input->begin(), input->end()); }
+				void reset ()
+					{ average.clear(); updates = 0; }
+				void run ();
+		};
+
+		std::vector<std::unique_ptr<Estimator>> estimators;
+		std::vector<std::vector<float>> psd;
+		QThreadPool pool;
+		mutable QMutex mutex;
+		quint32 segmentSize = 1024;
+		quint32 averages = 32;
+		quint32 interval = 8;
+		quint32 counter = 0;
+		bool enabled = true;
+
+		void publish (quint32 stream, quint32 stage, std::vector<double> const& average);
+
+	public:
+
+		enum Stages {
+			Raw = 0,
+			Filtered,
+			TotalStages
+		};
+
+		NoiseMonitor();
+		NoiseMonitor (const NoiseMonitor&) = delete;
+		~NoiseMonitor();
+
+		void set_streams (quint32 streams);
+		quint32 get_streams () const
+			{ return estimators.size()/TotalStages; }
+		void set_enabled (bool state)
+			{ enabled = state; }
+		bool get_enabled () const
+			{ return enabled; }
+		void set_segment_size (quint32 size);
+		quint32 get_segment_size () const
+			{ return segmentSize; }
+		// Exponential averaging over about this many analysed buffers
+		void set_averages (quint32 count);
+		quint32 get_averages () const
+			{ return averages; }
+		void set_interval (quint32 buffers)
+			{ interval = buffers ? buffers : 1; }
+		quint32 get_interval () const
+			{ return interval; }
+		void reset ();
+
+		// Called with the buffers of every processing cycle
+		void feed (std::vector<std::vector<float> const*> const& raw, std::vector<std::vector<float> const*> const& filtered);
+
+		// One sided density, segment/2 + 1 bins, in units of power per unit
+		// of frequency normalized to the sample rate
+		std::vector<float> get_psd (quint32 stream, quint32 stage) const;
+};
+
+#endif // NOISEMONITOR_HPP
@@ -23,10 +23,19 @@
 
 namespace Neural_Network {
 
-NuclTeachingClass::NuclTeachingClass() : TeachingClass(), fft(128) {
-	gauChance = new std::normal_distribution<float> (0.f, 1.f);
-	linChance = new std::uniform_real_distribution<float> (0.f, 1.f);
-	generator.seed(std::time(0));
+// Teaching pulses per random stream
+static const quint32 GenerationBlock = 1024;
+
+void PulseWorkspace::seed(quint32 _seed, quint32 _stream) {
+	std::seed_seq seq {_seed, _stream};
+	generator.seed(seq);
+	gauChance.reset();
+	linChance.reset();
+}
+
+NuclTeachingClass::NuclTeachingClass() : TeachingClass() {
+	thisPool = std::shared_ptr<QThreadPool> (new QThreadPool);
+	set_seed(std::time(0));
 
 	sincTab.resize(interMult*interPrec);
 	for (int32_t i = 0; i < (int32_t)sincTab.size(); i++) {
@@ -37,14 +46,6 @@ NuclTeachingClass::NuclTeachingClass() : TeachingClass(), fft(128) {
 }
 
 NuclTeachingClass::~NuclTeachingClass () {
-	delete gauChance;
-	delete linChance;
-}
-
-std::vector<float> NuclTeachingClass::get_random(quint32 size) {
-	std::vector<float> out(size);
-	for (quint32 i = 0; i < size; i++) out[i] = (*gauChance)(generator);
-	return out;
 }
 
 void NuclTeachingClass::init_noizes() {
@@ -59,20 +60,22 @@ void NuclTeachingClass::init_noizes() {
 	}
 }
 
-void NuclTeachingClass::add_noize(std::vector<float>::iterator iter, quint32 size) {
-	fft.set_size(size);
-	std::vector<float> noizeBuff(size, 0.f);
+void NuclTeachingClass::add_noize(PulseWorkspace &ws, float *out, quint32 size) const {
+	ws.fft.set_size(size);
+	ws.noizeBuff.assign(size, 0.f);
+	ws.random.resize(size);
 	for (auto a = noizeAFCs.begin(); a != noizeAFCs.end(); a++) {
-		fft.set_time_data(get_random(size));
-		fft.go(false);
-		std::vector<float> tmpFilter (*a);
-		float tmpAmpl = (*gauChance)(generator);
-		for (auto &b: tmpFilter) b *= tmpAmpl;
-		fft.filtering(tmpFilter);
-		fft.go(true);
-		for (quint32 i = 0, ie = noizeBuff.size(); i < ie; i++) noizeBuff[i] += fft.get_time_data()[i].real();
+		for (quint32 i = 0; i < size; i++) ws.random[i] = ws.gauChance(ws.generator);
+		ws.fft.set_time_data(ws.random);
+		ws.fft.go(false);
+		ws.filter = *a;
+		float tmpAmpl = ws.gauChance(ws.generator);
+		for (auto &b: ws.filter) b *= tmpAmpl;
+		ws.fft.filtering(ws.filter);
+		ws.fft.go(true);
+		for (quint32 i = 0, ie = ws.noizeBuff.size(); i < ie; i++) ws.noizeBuff[i] += ws.fft.get_time_data()[i].real();
 	}
-	overlay(iter, noizeBuff);
+	for (quint32 i = 0; i < size; ++i) out[i] += ws.noizeBuff[i];
 }
 /*
 void NuclTeachingClass::add_noize_shaped(std::vector<float>::iterator iter, quint32 size) {
@@ -102,13 +105,13 @@ void NuclTeachingClass::add_noize_shaped(std::vector<float>::iterator iter, quin
 	overlay(iter, noizeBuff2);
 }
 */
-void NuclTeachingClass::overlay(std::vector<float>::iterator iter, const std::vector<float>& input, float magnitude) {
+void NuclTeachingClass::overlay(std::vector<float>::iterator iter, const std::vector<float>& input, float magnitude) const {
 	for (quint32 i = 0, ie = input.size(); i < ie; ++i) {
 		*(iter+i) += magnitude*input[i];
 	}
 }
 
-std::vector<float> NuclTeachingClass::interpolate(const std::vector<float> &input) {
+std::vector<float> NuclTeachingClass::interpolate(const std::vector<float> &input) const {
 	std::vector<float> output (input.size()*interMult, 0.f);
 	std::vector<float> tmp (input.size() + interPrec);
 
@@ -129,11 +132,9 @@ std::vector<float> NuclTeachingClass::interpolate(const std::vector<float> &inpu
 	return output;
 }
 
-std::vector<float> NuclTeachingClass::deinterpolate(const std::vector<float> &input, quint32 displ) {
+void NuclTeachingClass::deinterpolate(const std::vector<float> &input, float *output, quint32 displ) const {
 	assert(displ < interMult);
-	std::vector<float> output (input.size()/interMult);
-	for (quint32 i = 0, ie = output.size(); i < ie; i++) output[i] = input[i*interMult + displ];
-	return output;
+	for (quint32 i = 0, ie = input.size()/interMult; i < ie; i++) output[i] = input[i*interMult + displ];
 }
 
 void NuclTeachingClass::set_noize(qint32 order, float magn, float diff) {
@@ -184,33 +185,58 @@ void NuclTeachingClass::set_pulse(const std::vector<float> &_pulse) {
 	for (quint32 i = 0, ie = interpolated.size(); i < ie; ++i) interpolated[i] /= max;
 }
 
+void NuclTeachingClass::GenerationThread::run() {
+	for (quint32 block = first, blocks = (teach->teachData.size() + GenerationBlock - 1)/GenerationBlock; block < blocks; block += step) {
+		ws.seed(teach->seed, block);
+		for (quint32 i = block*GenerationBlock, ie = std::min(i + GenerationBlock, teach->teachData.size()); i < ie; ++i)
+			teach->make_pulse(ws, teach->teachData.input(i), teach->teachData.target(i));
+	}
+}
+
+void NuclTeachingClass::generate_set() {
+	const quint32 blocks = (teachData.size() + GenerationBlock - 1)/GenerationBlock;
+	const quint32 threads = std::max<quint32> (std::min<quint32> (thisPool->maxThreadCount(), blocks), 1);
+	std::vector<GenerationThread> generators (threads);
+	for (quint32 t = 0; t < threads; ++t) {
+		generators[t].teach = this;
+		generators[t].first = t;
+		generators[t].step = threads;
+		thisPool->start(&generators[t]);
+	}
+	thisPool->waitForDone();
+	++seed;
+}
+
 double NuclTeachingClass::start(NuclearPhysicsNeuralNet *_percep, quint32 iterations) {
 	assert_nn(_percep);
 
-	teachData.resize(iterations);
-	for (auto& a: teachData) {
-		a.first.resize(pulse.size());
-		a.second.resize(_percep->outputs());
-	}
+	teachData.resize(iterations, pulse.size(), _percep->outputs());
 	init_noizes();
-	for (quint32 i = 0; i < iterations; ++i) {
-		teachData[i] = generate_pulse();
-	}
+	generate_set();
 	return TeachingClass::start(_percep);
 }
 
+std::pair<std::vector<float>, std::vector<float>> NuclTeachingClass::generate_pulse() {
+	std::pair<std::vector<float>, std::vector<float>> out (std::vector<float> (pulse.size()), std::vector<float> (1));
+	make_pulse(mainWorkspace, out.first.data(), out.second.data());
+	return out;
+}
+
 void NuclAmplTeachingClass::assert_nn(NuclearPhysicsNeuralNet *_percep) {
 	assert(_percep->outputs() == 1 && _percep->get_function(0) == AvailableFunctions::Amplitude);
 }
 
-std::pair<std::vector<float>, std::vector<float>> NuclAmplTeachingClass::generate_pulse() {
+void NuclAmplTeachingClass::make_pulse(PulseWorkspace &_ws, float *_input, float *_target) const {
 
-	float baseline = .05f*(*gauChance)(generator);
-	float baselineLinDrift = 0.05*(*gauChance)(generator)/interpolated.size();
+	float* out = _input;
+	const quint32 size = pulse.size();
+	float baseline = .05f*_ws.gauChance(_ws.generator);
+	float baselineLinDrift = 0.05*_ws.gauChance(_ws.generator)/interpolated.size();
 
-	std::vector<float> a (interpolated.size(), baseline);
-	std::vector<float> b (3*interpolated.size(), 0.f);
-	std::vector<float> out;
+	std::vector<float>& a = _ws.a;
+	a.assign(interpolated.size(), baseline);
+	std::vector<float>& b = _ws.b;
+	b.resize(3*interpolated.size());
 	for (quint32 i = 0, ie = interpolated.size(); i < ie; i++) {
 		a[i] += baselineLinDrift*i;
 	}
@@ -219,9 +245,9 @@ std::pair<std::vector<float>, std::vector<float>> NuclAmplTeachingClass::generat
 	for (quint32 i = 2*b.size()/3, ie = b.size(); i < ie; ++i) b[i] = interpolated[interpolated.size()-1];
 	memcpy(b.data() + b.size()/3, interpolated.data(), 4*interpolated.size());
 
-	if ((*linChance)(generator) < 0.35) {
-		quint32 overlayPos = b.size()/3 + interpolated.size()*((*linChance)(generator) + 0.25f)/1.25f;
-		float overlayMagn = (0.2f + 1.7*(*linChance)(generator));
+	if (_ws.linChance(_ws.generator) < 0.35) {
+		quint32 overlayPos = b.size()/3 + interpolated.size()*(_ws.linChance(_ws.generator) + 0.25f)/1.25f;
+		float overlayMagn = (0.2f + 1.7*_ws.linChance(_ws.generator));
 		overlay(b.begin() + overlayPos, interpolated, overlayMagn);
 	}
 	/*if ((*linChance)(generator) < 0.25) {
@@ -231,33 +257,36 @@ std::pair<std::vector<float>, std::vector<float>> NuclAmplTeachingClass::generat
 	}*/
 
 	qint32 pulsePos;
-	if (pulMaxTime > 0.25f) pulsePos = interpolated.size()*((*linChance)(generator) - .5f)/2.f;
-	else pulsePos = pulMaxTime*interpolated.size()*(2.f*(*linChance)(generator) - 1.f);
+	if (pulMaxTime > 0.25f) pulsePos = interpolated.size()*(_ws.linChance(_ws.generator) - .5f)/2.f;
+	else pulsePos = pulMaxTime*interpolated.size()*(2.f*_ws.linChance(_ws.generator) - 1.f);
 	for (quint32 i = 0, ie = a.size(); i < ie; ++i) a[i] += b[i + b.size()/3 - pulsePos];
 
 	float resultedAmpl1 = *std::max_element(a.begin(), a.end());
 	for (quint32 i = 0, ie = a.size(); i < ie; ++i) a[i] /= resultedAmpl1;
 
-	out = deinterpolate(a, interMult*(*linChance)(generator));
-	add_noize(out.begin(), out.size());
-	float resultedAmpl2 = *std::max_element(out.begin(), out.end());
-	for (quint32 i = 0, ie = out.size(); i < ie; ++i) out[i] /= resultedAmpl2;
+	deinterpolate(a, out, interMult*_ws.linChance(_ws.generator));
+	add_noize(_ws, out, size);
+	float resultedAmpl2 = *std::max_element(out, out + size);
+	for (quint32 i = 0, ie = size; i < ie; ++i) out[i] /= resultedAmpl2;
 
-	return std::pair<std::vector<float>, std::vector<float>> (out, std::vector<float> (1, .5f/(resultedAmpl1*resultedAmpl2)));
+	_target[0] = .5f/(resultedAmpl1*resultedAmpl2);
 }
 
 void NuclTimeTeachingClass::assert_nn(NuclearPhysicsNeuralNet *_percep) {
 	assert(_percep->outputs() == 1 && _percep->get_function(0) == AvailableFunctions::Time);
 }
 
-std::pair<std::vector<float>, std::vector<float>> NuclTimeTeachingClass::generate_pulse() {
+void NuclTimeTeachingClass::make_pulse(PulseWorkspace &_ws, float *_input, float *_target) const {
 
-	float baseline = .05f*(*gauChance)(generator);
-	float baselineLinDrift = 0.05*(*gauChance)(generator)/interpolated.size();
+	float* out = _input;
+	const quint32 size = pulse.size();
+	float baseline = .05f*_ws.gauChance(_ws.generator);
+	float baselineLinDrift = 0.05*_ws.gauChance(_ws.generator)/interpolated.size();
 
-	std::vector<float> a (interpolated.size(), baseline);
-	std::vector<float> b (3*interpolated.size(), 0.f);
-	std::vector<float> out;
+	std::vector<float>& a = _ws.a;
+	a.assign(interpolated.size(), baseline);
+	std::vector<float>& b = _ws.b;
+	b.resize(3*interpolated.size());
 	for (quint32 i = 0, ie = interpolated.size(); i < ie; i++) {
 		a[i] += baselineLinDrift*i;
 	}
@@ -266,9 +295,9 @@ std::pair<std::vector<float>, std::vector<float>> NuclTimeTeachingClass::generat
 	for (quint32 i = 2*b.size()/3, ie = b.size(); i < ie; ++i) b[i] = interpolated[interpolated.size()-1];
 	memcpy(b.data() + b.size()/3, interpolated.data(), 4*interpolated.size());
 
-	if ((*linChance)(generator) < 0.35) {
-		quint32 overlayPos = b.size()/3 + interpolated.size()*((*linChance)(generator) + 0.25f)/1.25f;
-		float overlayMagn = (0.2f + 1.7*(*linChance)(generator));
+	if (_ws.linChance(_ws.generator) < 0.35) {
+		quint32 overlayPos = b.size()/3 + interpolated.size()*(_ws.linChance(_ws.generator) + 0.25f)/1.25f;
+		float overlayMagn = (0.2f + 1.7*_ws.linChance(_ws.generator));
 		overlay(b.begin() + overlayPos, interpolated, overlayMagn);
 	}
 	/*if ((*linChance)(generator) < 0.25) {
@@ -278,46 +307,49 @@ std::pair<std::vector<float>, std::vector<float>> NuclTimeTeachingClass::generat
 	}*/
 
 	qint32 pulsePos;
-	if (pulMaxTime > 0.25f) pulsePos = interpolated.size()*((*linChance)(generator) - .5f)/2.f;
-	else pulsePos = pulMaxTime*interpolated.size()*(2.f*(*linChance)(generator) - 1.f);
+	if (pulMaxTime > 0.25f) pulsePos = interpolated.size()*(_ws.linChance(_ws.generator) - .5f)/2.f;
+	else pulsePos = pulMaxTime*interpolated.size()*(2.f*_ws.linChance(_ws.generator) - 1.f);
 	for (quint32 i = 0, ie = a.size(); i < ie; ++i) a[i] += b[i + b.size()/3 - pulsePos];
 
 	float resultedAmpl1 = *std::max_element(a.begin(), a.end());
 	for (quint32 i = 0, ie = a.size(); i < ie; ++i) a[i] /= resultedAmpl1;
 
-	out = deinterpolate(a, interMult*(*linChance)(generator));
-	add_noize(out.begin(), out.size());
-	float resultedAmpl2 = *std::max_element(out.begin(), out.end());
-	for (quint32 i = 0, ie = out.size(); i < ie; ++i) out[i] /= resultedAmpl2;
+	deinterpolate(a, out, interMult*_ws.linChance(_ws.generator));
+	add_noize(_ws, out, size);
+	float resultedAmpl2 = *std::max_element(out, out + size);
+	for (quint32 i = 0, ie = size; i < ie; ++i) out[i] /= resultedAmpl2;
 
-	return std::pair<std::vector<float>, std::vector<float>> (out, std::vector<float> (1, pulMaxTime + (float)pulsePos/(float)interpolated.size()));
+	_target[0] = pulMaxTime + (float)pulsePos/(float)interpolated.size();
 }
 
 void NuclDiscrTeachingClass::assert_nn(NuclearPhysicsNeuralNet *_percep) {
 	assert(_percep->outputs() == 1 && _percep->get_function(0) == AvailableFunctions::Discriminating);
 }
 
-std::pair<std::vector<float>, std::vector<float>> NuclDiscrTeachingClass::generate_pulse() {
+void NuclDiscrTeachingClass::make_pulse(PulseWorkspace &_ws, float *_input, float *_target) const {
 
-	float baseline = .05f*(*gauChance)(generator);
-	float baselineLinDrift = 0.05*(*gauChance)(generator)/interpolated.size();
+	float* out = _input;
+	const quint32 size = pulse.size();
+	float baseline = .05f*_ws.gauChance(_ws.generator);
+	float baselineLinDrift = 0.05*_ws.gauChance(_ws.generator)/interpolated.size();
 
-	std::vector<float> a (interpolated.size(), baseline);
-	std::vector<float> b (3*interpolated.size(), 0.f);
-	std::vector<float> out;
+	std::vector<float>& a = _ws.a;
+	a.assign(interpolated.size(), baseline);
+	std::vector<float>& b = _ws.b;
+	b.resize(3*interpolated.size());
 	for (quint32 i = 0, ie = interpolated.size(); i < ie; i++) {
 		a[i] += baselineLinDrift*i;
 	}
 
-	if ((*linChance)(generator) > 0.5f) {
+	if (_ws.linChance(_ws.generator) > 0.5f) {
 
 		for (quint32 i = 0, ie = b.size()/3; i < ie; ++i) b[i] = interpolated[0];
 		for (quint32 i = 2*b.size()/3, ie = b.size(); i < ie; ++i) b[i] = interpolated[interpolated.size()-1];
 		memcpy(b.data() + b.size()/3, interpolated.data(), 4*interpolated.size());
 
-		if ((*linChance)(generator) < 0.35) {
-			quint32 overlayPos = b.size()/3 + interpolated.size()*((*linChance)(generator) + 0.25f)/1.25f;
-			float overlayMagn = (0.2f + 1.7*(*linChance)(generator));
+		if (_ws.linChance(_ws.generator) < 0.35) {
+			quint32 overlayPos = b.size()/3 + interpolated.size()*(_ws.linChance(_ws.generator) + 0.25f)/1.25f;
+			float overlayMagn = (0.2f + 1.7*_ws.linChance(_ws.generator));
 			overlay(b.begin() + overlayPos, interpolated, overlayMagn);
 		}
 		/*if ((*linChance)(generator) < 0.25) {
@@ -327,40 +359,40 @@ std::pair<std::vector<float>, std::vector<float>> NuclDiscrTeachingClass::genera
 		}*/
 
 		qint32 pulsePos;
-		if (pulMaxTime > 0.25f) pulsePos = interpolated.size()*((*linChance)(generator) - .5f)/2.f;
-		else pulsePos = pulMaxTime*interpolated.size()*(2.f*(*linChance)(generator) - 1.f);
+		if (pulMaxTime > 0.25f) pulsePos = interpolated.size()*(_ws.linChance(_ws.generator) - .5f)/2.f;
+		else pulsePos = pulMaxTime*interpolated.size()*(2.f*_ws.linChance(_ws.generator) - 1.f);
 		for (quint32 i = 0, ie = a.size(); i < ie; ++i) a[i] += b[i + b.size()/3 - pulsePos];
 
 		float resultedAmpl1 = *std::max_element(a.begin(), a.end());
 		for (quint32 i = 0, ie = a.size(); i < ie; ++i) a[i] /= resultedAmpl1;
 
 
-		out = deinterpolate(a, interMult*(*linChance)(generator));
-		add_noize(out.begin(), out.size());
-		float resultedAmpl2 = *std::max_element(out.begin(), out.end());
-		for (quint32 i = 0, ie = out.size(); i < ie; ++i) out[i] /= resultedAmpl2;
+		deinterpolate(a, out, interMult*_ws.linChance(_ws.generator));
+		add_noize(_ws, out, size);
+		float resultedAmpl2 = *std::max_element(out, out + size);
+		for (quint32 i = 0, ie = size; i < ie; ++i) out[i] /= resultedAmpl2;
 
-		return std::pair<std::vector<float>, std::vector<float>> (out, std::vector<float> (1, 0.95));
+		_target[0] = 0.95;
 	} else {
 
-		out = deinterpolate(a, interMult*(*linChance)(generator));
-		add_noize(out.begin(), out.size());
-		float parabMagn = .05f*(*gauChance)(generator);
+		deinterpolate(a, out, interMult*_ws.linChance(_ws.generator));
+		add_noize(_ws, out, size);
+		float parabMagn = .05f*_ws.gauChance(_ws.generator);
 		if (parabMagn < 0.) parabMagn = -parabMagn;
 
-		if ((*linChance)(generator) > 0.5f) for (quint32 i = 0, ie = out.size(); i < ie; ++i) {
+		if (_ws.linChance(_ws.generator) > 0.5f) for (quint32 i = 0, ie = size; i < ie; ++i) {
 			float t = (2.f*i - ie)/ie;
 			out[i] += parabMagn * (1.f - 2*t*t);
 		}
 
-		float resultedAmpl2 = *std::max_element(out.begin(), out.end());
+		float resultedAmpl2 = *std::max_element(out, out + size);
 		if (resultedAmpl2 < 0.f) {
-			for (quint32 i = 0, ie = out.size(); i < ie; ++i) out[i] -= 1.25*resultedAmpl2;
-			resultedAmpl2 = *std::max_element(out.begin(), out.end());
+			for (quint32 i = 0, ie = size; i < ie; ++i) out[i] -= 1.25*resultedAmpl2;
+			resultedAmpl2 = *std::max_element(out, out + size);
 		}
 
-		for (quint32 i = 0, ie = out.size(); i < ie; ++i) out[i] /= resultedAmpl2;
-		return std::pair<std::vector<float>, std::vector<float>> (out, std::vector<float> (1, 0.05));
+		for (quint32 i = 0, ie = size; i < ie; ++i) out[i] /= resultedAmpl2;
+		_target[0] = 0.05;
 	}
 }
 
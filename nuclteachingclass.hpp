@@ -24,8 +24,11 @@
 #include "teachingclass.hpp"
 #include "nuclearphysicsperceptron.hpp"
 #include "fft.hpp"
+#include <QThreadPool>
+#include <QRunnable>
 #include <random>
 #include <list>
+#include <memory>
 
 namespace Neural_Network {
 
@@ -35,16 +38,47 @@ struct NoizeInfo {
 		float diff = 0.f;
 };
 
+// State one thread needs to generate teaching pulses: random streams, FFT
+// and scratch buffers, reused from pulse to pulse
+struct PulseWorkspace {
+		std::default_random_engine generator;
+		std::normal_distribution<float> gauChance;
+		std::uniform_real_distribution<float> linChance;
+		FFT<float> fft;
+		std::vector<float> a;
+		std::vector<float> b;
+		std::vector<float> random;
+		std::vector<float> filter;
+		std::vector<float> noizeBuff;
+
+		PulseWorkspace() : gauChance(0.f, 1.f), linChance(0.f, 1.f), fft(128) {}
+		void seed (quint32 _seed, quint32 _stream);
+};
+
 class NuclTeachingClass : public TeachingClass {
 
+		// Generates blocks first, first + step, ... of the teaching set
+		class GenerationThread : public QRunnable {
+			public:
+				NuclTeachingClass* teach = nullptr;
+				quint32 first = 0;
+				quint32 step = 1;
+				PulseWorkspace ws;
+
+				GenerationThread() : QRunnable() { setAutoDelete(false); }
+				virtual ~GenerationThread() {}
+				void run();
+		};
+
 	protected:
 
-		std::default_random_engine generator;
-		std::normal_distribution<float>* gauChance;
-		std::uniform_real_distribution<float>* linChance;
 		std::list<NoizeInfo> ni;
 		std::vector<std::vector<float>> noizeAFCs;
-		FFT<float> fft;
+		std::shared_ptr<QThreadPool> thisPool;
+		PulseWorkspace mainWorkspace;
+		// Every block of the teaching set draws from its own stream seeded with
+		// (seed, block), so the set does not depend on the number of threads
+		quint32 seed;
 
 		std::vector<float> pulse;
 		std::vector<float> interpolated;
@@ -53,17 +87,19 @@ class NuclTeachingClass : public TeachingClass {
 		quint32 interPrec = 32;
 		float pulMaxTime;
 
-		std::vector<float> get_random (quint32 size);
-		void add_noize(std::vector<float>::iterator iter, quint32 size);
+		void add_noize(PulseWorkspace& ws, float* out, quint32 size) const;
 		//void add_noize_shaped(std::vector<float>::iterator iter, quint32 size);
-		void overlay(std::vector<float>::iterator iter, const std::vector<float>& input, float magnitude = 1.f);
+		void overlay(std::vector<float>::iterator iter, const std::vector<float>& input, float magnitude = 1.f) const;
+		void generate_set ();
 
-		std::vector<float> interpolate (const std::vector<float>& input);
-		std::vector<float> deinterpolate (const std::vector<float>& input, quint32 displ = 0);
+		std::vector<float> interpolate (const std::vector<float>& input) const;
+		void deinterpolate (const std::vector<float>& input, float* output, quint32 displ = 0) const;
 
 		virtual void assert_nn(NuclearPhysicsNeuralNet *_percep) = 0;
+		// Writes one pulse of pulse.size() samples to '_input' and its
+		// expected net outputs to '_target'. Must only touch '_ws'.
+		virtual void make_pulse (PulseWorkspace& _ws, float* _input, float* _target) const = 0;
 
-		float lastTime;
 	public:
 
 		NuclTeachingClass();
@@ -75,42 +111,48 @@ class NuclTeachingClass : public TeachingClass {
 		void init_noizes();
 		NoizeInfo get_noize (qint32 order);
 		void reset_noizes ();
+		// Every start generates its set from the current seed and then advances it
+		void set_seed (quint32 _seed) { seed = _seed; mainWorkspace.seed(seed, 0); }
+		quint32 get_seed () const { return seed; }
 
 		double start (NuclearPhysicsNeuralNet *_percep, quint32 iterations);
-		virtual std::pair<std::vector<float>, std::vector<float>> generate_pulse () = 0;
+		std::pair<std::vector<float>, std::vector<float>> generate_pulse ();
 };
 
 class NuclAmplTeachingClass : public NuclTeachingClass {
 
+	protected:
+		void make_pulse (PulseWorkspace& _ws, float* _input, float* _target) const;
+
 	public:
 		NuclAmplTeachingClass() : NuclTeachingClass() {}
 		virtual ~NuclAmplTeachingClass() {}
 
 		void assert_nn (NuclearPhysicsNeuralNet *_percep);
-
-		std::pair<std::vector<float>, std::vector<float> > generate_pulse();
 };
 
 class NuclTimeTeachingClass : public NuclTeachingClass {
 
+	protected:
+		void make_pulse (PulseWorkspace& _ws, float* _input, float* _target) const;
+
 	public:
 		NuclTimeTeachingClass() : NuclTeachingClass() {}
 		virtual ~NuclTimeTeachingClass() {}
 
 		void assert_nn (NuclearPhysicsNeuralNet *_percep);
-
-		std::pair<std::vector<float>, std::vector<float> > generate_pulse();
 };
 
 class NuclDiscrTeachingClass : public NuclTeachingClass {
 
+	protected:
+		void make_pulse (PulseWorkspace& _ws, float* _input, float* _target) const;
+
 	public:
 		NuclDiscrTeachingClass() : NuclTeachingClass() {}
 		virtual ~NuclDiscrTeachingClass() {}
 
 		void assert_nn (NuclearPhysicsNeuralNet *_percep);
-
-		std::pair<std::vector<float>, std::vector<float> > generate_pulse();
 };
 
 }
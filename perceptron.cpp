@@ -127,7 +127,7 @@ void Perceptron::save(std::ostream &saveStream) const {
 	for (quint32 l = 0; l < layers(); ++l) for (quint32 n = 0; n < neurons(l); ++n) {
 		saveStream.write((char*)(get_weights(l, n).data()), 4 * weights(l, n));
 		saveStream.write((char*)(&(tmp = get_const (l, n))), 4);
-		saveStream.write((char*)(&(tmp = get_func_id(l, n))), 4);
+		saveStream.write((char*)(&(itmp = get_func_id(l, n))), 4);
 	}
 }
 
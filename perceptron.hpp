@@ -47,8 +47,8 @@ class Perceptron {
 		void set_weight (float _weight, quint32 _layer, quint32 _neuron_index, quint32 _weight_index) { neuronsVec[_layer][_neuron_index].set_weight (_weight, _weight_index); }
 		void set_weight (const std::vector<float>& _weights, quint32 _layer, quint32 _neuron_index);
 		void set_const (float _const, quint32 _layer, quint32 _neuron) { neuronsVec[_layer][_neuron].set_const(_const); }
-		void set_activation_function (quint32 _layer, quint32 _neuron, Activation_Function* _actfunc) { neuronsVec[_layer][_neuron].set_activation_function(_actfunc); }
 		void set_activation_function (quint32 _layer, quint32 _neuron, quint32 _actfunc_id) { neuronsVec[_layer][_neuron].set_activation_function(_actfunc_id); }
+		void set_activation_function (quint32 _layer, quint32 _actfunc_id) { for (auto& n: neuronsVec[_layer]) n.set_activation_function(_actfunc_id); }
 		std::vector<float> get_error (const std::vector<float>& _inputVec, const std::vector<float>& _outputVec);
 		const std::vector<float>& get_weights (quint32 layer, quint32 neuron) const { return neuronsVec[layer][neuron].get_weights(); }
 		quint32 neurons (quint32 _layer) const { return neuronsVec[_layer].size(); }
@@ -56,7 +56,7 @@ class Perceptron {
 		quint32 weights (quint32 _layer, quint32 _neuron) const { return neuronsVec[_layer][_neuron].inputs(); }
 		float get_const (quint32 _layer, quint32 _neuron) const { return neuronsVec[_layer][_neuron].get_const(); }
 		float get_func_diff (quint32 _layer, quint32 _neuron) const { return neuronsVec[_layer][_neuron].get_func_diff(); }
-		float get_func_id (quint32 _layer, quint32 _neuron) const { return neuronsVec[_layer][_neuron].get_func_id(); }
+		quint32 get_func_id (quint32 _layer, quint32 _neuron) const { return neuronsVec[_layer][_neuron].get_func_id(); }
 		float get_output (quint32 _index) { if (neuronsVec.empty()) return 0.f; else return neuronsVec[neuronsVec.size()-1][_index]; }
 		quint32 total_neurons () const;
 		quint32 total_weights () const;
@@ -23,6 +23,12 @@
 #include "processingsettings.hpp"
 #include "processing.hpp"
 
+static float window_baseline (std::vector<float>::iterator begPulse, quint32 samples) {
+	if (!samples) return 0.f;
+	float bl = 0.f;
+	for (auto curr = begPulse, end = begPulse + samples; curr != end; ++curr) bl += *curr;
+	return bl / static_cast<float> (samples);
+}
 
 void PulseSearching::search(std::vector<float>::iterator _begin, std::vector<float>::iterator _end, quint32 _begPos) {
 	begin = _begin;
@@ -212,9 +218,16 @@ quint8 PulseSearchingTanThreshold::check_pulse(std::vector<float>::iterator curr
 void PulseDiscriminator::set (std::shared_ptr<ProcessingThread::Settings> d) {
 	assert(get_disc_type() == d->dSet->get_d_settings_id());
 	settings = d;
+	kernels = PulseKernels::get(settings->pulseSize);
 	update_settings();
 }
 
+void PulseDiscriminator::discriminate_batch(std::vector<float>::iterator begin, quint32 count, std::vector<quint8> &result) {
+	const quint32 size = settings->pulseSize;
+	result.resize(count);
+	for (quint32 i = 0; i < count; ++i, begin += size) result[i] = discriminate(begin, begin + size);
+}
+
 std::shared_ptr<PulseDiscriminator> PulseDiscriminator::get_new (quint32 id) {
 	switch (id) {
 		case PulseDiscriminator::Dispersion:
@@ -233,11 +246,7 @@ PulseDiscriminatorByDispersion::PulseDiscriminatorByDispersion () : PulseDiscrim
 quint8 PulseDiscriminatorByDispersion::discriminate(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse) {
 	DispDiscSettings* tmp = (DispDiscSettings*)settings->dSet.get();
 	assert ((std::vector<float>::size_type)(endPulse - begPulse) == settings->shape.size());
-	float tDisp (0.0f), fTmp;
-	for (auto curr = begPulse; curr != endPulse; ++curr) {
-		fTmp = *curr - settings->shape[curr-begPulse];
-		tDisp += fTmp*fTmp;
-	}
+	float tDisp = kernels.dispersion(&*begPulse, settings->shape.data(), settings->pulseSize);
 	tDisp /= static_cast<float> (settings->shape.size());
 	tDisp = std::sqrt (tDisp);
 	if (tDisp < tmp->maxDispersion) return 1;
@@ -264,25 +273,35 @@ PulseDiscriminatorByNeuralNet::PulseDiscriminatorByNeuralNet () : PulseDiscrimin
 }
 
 quint8 PulseDiscriminatorByNeuralNet::discriminate(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse) {
-	DiscNNSettings* tmp = (DiscNNSettings*)settings->dSet.get();
-	assert ((std::vector<float>::size_type)(endPulse - begPulse) == tmp->neuralNet.inputs());
+	assert ((std::vector<float>::size_type)(endPulse - begPulse) == net.inputs());
 
-	float bl = 0.f;
-	if (settings->aSet->processBaselineSamples) {
-		for (auto curr = begPulse, end = begPulse + settings->aSet->processBaselineSamples; curr != end; ++curr) bl += *curr;
-		bl /= static_cast<float> (settings->aSet->processBaselineSamples);
-	}
+	float bl = window_baseline(begPulse, settings->aSet->processBaselineSamples);
+	kernels.normalize(&*begPulse, nnInput.data(), bl, settings->pulseSize);
 
-	std::vector<float> tmpv (begPulse, endPulse);
-	for (auto a = tmpv.begin(), b = tmpv.end(); a != b; ++a) *a -= bl;
-	float maxVal = *std::max_element(begPulse, endPulse);
-	for (auto a = tmpv.begin(), b = tmpv.end(); a != b; ++a) *a /= maxVal;
-
-	tmp->neuralNet.work(tmpv);
-	if (tmp->neuralNet.get_output(0) > 0.5)	return 1;
+	net.work(nnInput.data());
+	if (net.get_output(0) > 0.5)	return 1;
 	else return 0;
 }
 
+void PulseDiscriminatorByNeuralNet::discriminate_batch(std::vector<float>::iterator begin, quint32 count, std::vector<quint8> &result) {
+	const quint32 size = settings->pulseSize;
+	nnBatch.resize(size, count);
+	for (quint32 i = 0; i < count; ++i, begin += size)
+		kernels.normalize(&*begin, nnBatch.col(i).data(), window_baseline(begin, settings->aSet->processBaselineSamples), size);
+
+	const Eigen::MatrixXf& out = qnet.work_batch(nnBatch);
+	result.resize(count);
+	for (quint32 i = 0; i < count; ++i) result[i] = out(0, i) > 0.5;
+}
+
+void PulseDiscriminatorByNeuralNet::update_settings() {
+	nnInput.resize(settings->pulseSize);
+	net.compile(((DiscNNSettings*)settings->dSet.get())->neuralNet);
+	net.set_fast_activation(settings->fastActivation);
+	// Output is compared with 0.5
+	qnet.set(&net, settings->quantizeNN, 0.02f);
+}
+
 void PulseDiscriminatorByNeuralNet::save(std::ostream &os) const {
 	DiscNNSettings& tmp = *(DiscNNSettings*)settings->dSet.get();
 	quint8 t = tmp.enabled;
@@ -296,15 +315,28 @@ void PulseDiscriminatorByNeuralNet::load(std::istream &is) {
 	is.read((char*)&t, 1);
 	tmp.enabled = t;
 	tmp.neuralNet.load(is);
+	update_settings();
 }
 
 void PulseAmplMeasuring::measure (std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse) {
 	pulseAmpl = find_ampl(begPulse, endPulse) * settings->amplCorrection;
 }
 
+void PulseAmplMeasuring::measure_batch (std::vector<float>::iterator begin, quint32 count, std::vector<float> &ampl) {
+	ampl.resize(count);
+	find_ampl_batch(begin, count, ampl.data());
+	for (auto& a: ampl) a *= settings->amplCorrection;
+}
+
+void PulseAmplMeasuring::find_ampl_batch (std::vector<float>::iterator begin, quint32 count, float *ampl) {
+	const quint32 size = settings->pulseSize;
+	for (quint32 i = 0; i < count; ++i, begin += size) ampl[i] = find_ampl(begin, begin + size);
+}
+
 void PulseAmplMeasuring::set (std::shared_ptr<ProcessingThread::Settings> a) {
 	assert(get_ampl_type() == a->aSet->get_a_settings_id());
 	settings = a;
+	kernels = PulseKernels::get(settings->pulseSize);
 	update_settings();
 }
 
@@ -370,16 +402,7 @@ float PulseAmplMeasuringPolyMax::find_ampl(std::vector<float>::iterator begPulse
 	assert (begPulse + tmp->maxValIntervalRight <= endPulse);
 	assert (endPulse - begPulse == settings->pulseSize);
 
-	Eigen::VectorXf vecTmp (tmp->polyOrder);
-	for (quint32 i = 0; i < tmp->polyOrder; ++i) {
-		vecTmp(i) = 0.f;
-		for (quint32 j = 0; j < settings->pulseSize; ++j)
-			vecTmp(i) += (*polyVectors[i])(j) * *(begPulse + j);
-	}
-	polyValues = polyMatrix * vecTmp;
-	polyRestoredPulse = Eigen::VectorXf::Zero(settings->pulseSize);
-	for (quint32 i = 0; i < tmp->polyOrder; ++i)
-		polyRestoredPulse += polyValues(i) * (*polyVectors[i]);
+	kernels.project(polyProjection, &*begPulse, polyRestoredPulse);
 
 	float bl = 0.f;
 	if (settings->aSet->processBaselineSamples) {
@@ -387,37 +410,29 @@ float PulseAmplMeasuringPolyMax::find_ampl(std::vector<float>::iterator begPulse
 		bl /= static_cast<float> (tmp->processBaselineSamples);
 	}
 
-	return *std::max_element(polyRestoredPulse.data() + tmp->maxValIntervalLeft, polyRestoredPulse.data() + tmp->maxValIntervalRight) - bl;
+	return polyRestoredPulse.maxCoeff() - bl;
 }
 
 void PulseAmplMeasuringPolyMax::update_settings() {
 	AmplPolyMaxSettings* tmp = (AmplPolyMaxSettings*)settings->aSet.get();
 	assert (tmp->maxValIntervalLeft < tmp->maxValIntervalRight);
 	assert (tmp->processBaselineSamples <= tmp->maxValIntervalLeft);
-
-	for (quint16 i = 0, iend = polyVectors.size(); i < iend; ++i)
-		delete polyVectors[i];
-	polyVectors.resize(0);
-	Eigen::VectorXf* vecTmp;
-	Eigen::MatrixXf matrTmp (tmp->polyOrder, tmp->polyOrder);
-	for (quint16 i = 0; i < tmp->polyOrder; ++i) {
-		vecTmp = new Eigen::VectorXf (settings->pulseSize);
-		for (quint16 j = 0; j < settings->pulseSize; ++j)
-			(*vecTmp)(j) = std::pow (static_cast<float> (j), i);
-		polyVectors.push_back(vecTmp);
-	}
-	for (quint16 i = 0; i < tmp->polyOrder; ++i) {
-		matrTmp(0, i) = (*polyVectors[0]).transpose() * (*polyVectors[i]);
-		for (quint16 j = 0; j < i; ++j)
-			matrTmp (i - j, j) = matrTmp(0, i);
-	}
-	for (quint16 i = 1; i < tmp->polyOrder; ++i) {
-		matrTmp(i, tmp->polyOrder - 1) = (*polyVectors[i]).transpose() * (*polyVectors[tmp->polyOrder - 1]);
-		for (quint16 j = 1; i + j < tmp->polyOrder; ++j)
-			matrTmp (i + j, tmp->polyOrder - 1 - j) = matrTmp(i, tmp->polyOrder - 1);
+	assert (tmp->maxValIntervalRight <= settings->pulseSize);
+
+	// Least squares fit restored only on [left, right): P * (V^T V)^-1 * V^T,
+	// where V(j, i) = j^i. Built in double, the Gram matrix is badly conditioned.
+	Eigen::MatrixXd polyBasis (settings->pulseSize, tmp->polyOrder);
+	for (quint32 j = 0; j < settings->pulseSize; ++j) {
+		double t = 1.;
+		for (quint32 i = 0; i < tmp->polyOrder; ++i) {
+			polyBasis(j, i) = t;
+			t *= j;
+		}
 	}
-	polyMatrix = matrTmp.inverse();
-	polyValues.resize(tmp->polyOrder);
+	Eigen::MatrixXd polyMatrix = (polyBasis.transpose() * polyBasis).inverse();
+	quint32 rangeSize = tmp->maxValIntervalRight - tmp->maxValIntervalLeft;
+	polyProjection = (polyBasis.middleRows(tmp->maxValIntervalLeft, rangeSize) * polyMatrix * polyBasis.transpose()).cast<float>();
+	polyRestoredPulse.resize(rangeSize);
 }
 
 void PulseAmplMeasuringPolyMax::save(std::ostream &os) const {
@@ -441,22 +456,31 @@ PulseAmplMeasuringNeuralNet::PulseAmplMeasuringNeuralNet() {
 }
 
 float PulseAmplMeasuringNeuralNet::find_ampl(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse) {
-	AmplNNSettings* tmp = (AmplNNSettings*)settings->aSet.get();
-	assert ((std::vector<float>::size_type)(endPulse - begPulse) == tmp->neuralNet.inputs());
+	assert ((std::vector<float>::size_type)(endPulse - begPulse) == net.inputs());
 
-	float bl = 0.f;
-	if (settings->aSet->processBaselineSamples) {
-		for (auto curr = begPulse, end = begPulse + tmp->processBaselineSamples; curr != end; ++curr) bl += *curr;
-		bl /= static_cast<float> (tmp->processBaselineSamples);
-	}
+	float bl = window_baseline(begPulse, settings->aSet->processBaselineSamples);
+	float maxVal = kernels.normalize(&*begPulse, nnInput.data(), bl, settings->pulseSize);
 
-	std::vector<float> tmpv (begPulse, endPulse);
-	for (auto a = tmpv.begin(), b = tmpv.end(); a != b; ++a) *a -= bl;
-	float maxVal = *std::max_element(begPulse, endPulse);
-	for (auto a = tmpv.begin(), b = tmpv.end(); a != b; ++a) *a /= maxVal;
+	net.work(nnInput.data());
+	return net.get_output(0)*2*maxVal;
+}
 
-	tmp->neuralNet.work(tmpv);
-	return tmp->neuralNet.get_output(0)*2*maxVal;
+void PulseAmplMeasuringNeuralNet::find_ampl_batch(std::vector<float>::iterator begin, quint32 count, float *ampl) {
+	const quint32 size = settings->pulseSize;
+	nnBatch.resize(size, count);
+	for (quint32 i = 0; i < count; ++i, begin += size)
+		ampl[i] = kernels.normalize(&*begin, nnBatch.col(i).data(), window_baseline(begin, settings->aSet->processBaselineSamples), size);
+
+	const Eigen::MatrixXf& out = qnet.work_batch(nnBatch);
+	for (quint32 i = 0; i < count; ++i) ampl[i] *= out(0, i)*2;
+}
+
+void PulseAmplMeasuringNeuralNet::update_settings() {
+	nnInput.resize(settings->pulseSize);
+	net.compile(((AmplNNSettings*)settings->aSet.get())->neuralNet);
+	net.set_fast_activation(settings->fastActivation);
+	// Relative amplitude error
+	qnet.set(&net, settings->quantizeNN, 2e-3f);
 }
 
 void PulseAmplMeasuringNeuralNet::save(std::ostream &os) const {
@@ -467,14 +491,21 @@ void PulseAmplMeasuringNeuralNet::save(std::ostream &os) const {
 void PulseAmplMeasuringNeuralNet::load(std::istream &is) {
 	AmplNNSettings& tmp = *(AmplNNSettings*)settings->aSet.get();
 	tmp.neuralNet.load(is);
+	update_settings();
 }
 
 void PulseTimeMeasuring::set (std::shared_ptr<ProcessingThread::Settings> t) {
 	assert(get_time_type() == t->tSet->get_t_settings_id());
 	settings = t;
+	kernels = PulseKernels::get(settings->pulseSize);
 	update_settings();
 }
 
+void PulseTimeMeasuring::find_time_batch (std::vector<float>::iterator begin, quint32 count, float *time) {
+	const quint32 size = settings->pulseSize;
+	for (quint32 i = 0; i < count; ++i, begin += size) time[i] = find_time(begin, begin + size);
+}
+
 std::shared_ptr<PulseTimeMeasuring> PulseTimeMeasuring::get_new (quint32 id) {
 	switch (id) {
 		case PulseTimeMeasuring::MaxVal:
@@ -521,22 +552,31 @@ PulseTimeMeasuringNeuralNet::PulseTimeMeasuringNeuralNet() {
 }
 
 float PulseTimeMeasuringNeuralNet::find_time(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse) {
-	TimeNNSettings* tmp = (TimeNNSettings*)settings->tSet.get();
-	assert ((std::vector<float>::size_type)(endPulse - begPulse) == tmp->neuralNet.inputs());
+	assert ((std::vector<float>::size_type)(endPulse - begPulse) == net.inputs());
 
-	float bl = 0.f;
-	if (settings->aSet->processBaselineSamples) {
-		for (auto curr = begPulse, end = begPulse + settings->aSet->processBaselineSamples; curr != end; ++curr) bl += *curr;
-		bl /= static_cast<float> (settings->aSet->processBaselineSamples);
-	}
+	float bl = window_baseline(begPulse, settings->aSet->processBaselineSamples);
+	kernels.normalize(&*begPulse, nnInput.data(), bl, settings->pulseSize);
 
-	std::vector<float> tmpv (begPulse, endPulse);
-	for (auto a = tmpv.begin(), b = tmpv.end(); a != b; ++a) *a -= bl;
-	float maxVal = *std::max_element(begPulse, endPulse);
-	for (auto a = tmpv.begin(), b = tmpv.end(); a != b; ++a) *a /= maxVal;
+	net.work(nnInput.data());
+	return net.get_output(0)*settings->pulseSize;
+}
+
+void PulseTimeMeasuringNeuralNet::find_time_batch(std::vector<float>::iterator begin, quint32 count, float *time) {
+	const quint32 size = settings->pulseSize;
+	nnBatch.resize(size, count);
+	for (quint32 i = 0; i < count; ++i, begin += size)
+		kernels.normalize(&*begin, nnBatch.col(i).data(), window_baseline(begin, settings->aSet->processBaselineSamples), size);
 
-	tmp->neuralNet.work(tmpv);
-	return tmp->neuralNet.get_output(0)*settings->pulseSize;
+	const Eigen::MatrixXf& out = qnet.work_batch(nnBatch);
+	for (quint32 i = 0; i < count; ++i) time[i] = out(0, i)*size;
+}
+
+void PulseTimeMeasuringNeuralNet::update_settings() {
+	nnInput.resize(settings->pulseSize);
+	net.compile(((TimeNNSettings*)settings->tSet.get())->neuralNet);
+	net.set_fast_activation(settings->fastActivation);
+	// Fraction of the pulse window
+	qnet.set(&net, settings->quantizeNN, 2e-3f);
 }
 
 void PulseTimeMeasuringNeuralNet::save(std::ostream &os) const {
@@ -547,10 +587,12 @@ void PulseTimeMeasuringNeuralNet::save(std::ostream &os) const {
 void PulseTimeMeasuringNeuralNet::load(std::istream &is) {
 	TimeNNSettings& tmp = *(TimeNNSettings*)settings->tSet.get();
 	tmp.neuralNet.load(is);
+	update_settings();
 }
 
 ProcessingThread::ProcessingThread(quint32 specSize) {
 	spectrum.resize(specSize, 0);
+	kernels = PulseKernels::get(32);
 	qRegisterMetaType<PulseInfo>("PulseInfo");
 	callback = [&] () {
 				std::vector<float>::iterator pos = pulSearch->get_iter();
@@ -561,32 +603,83 @@ ProcessingThread::ProcessingThread(quint32 specSize) {
 					pulAmpl->measure(pos, pos + settings->pulseSize);
 					pulTime->measure(pos, pos + settings->pulseSize);
 
-					if (isPulseCollect) {
-						std::vector<float> a (pos, pos + settings->pulseSize);
-						if (settings->aSet->processBaselineSamples) {
-							float bl = 0.f;
-							for (auto b = a.begin(), be = b + settings->aSet->processBaselineSamples; b != be; ++b)
-								bl += *b;
-							bl /= settings->aSet->processBaselineSamples;
-							for (auto &b: a) b -= bl;
-						}
-						setupDetectedPulses.push_back(a);
-					}
-					if (isSpectCollect) add_to_spectrum();
+					if (isPulseCollect) collect_pulse(pos);
+					if (isSpectCollect) add_to_spectrum(pulAmpl->get_ampl());
 
 					lastDetectInfo.pos = pulSearch->get_pos();
 					lastDetectInfo.ampl = pulAmpl->get_ampl();
 					lastDetectInfo.time = pulTime->get_time();
-					if (settings->enableSub) subtract(pos);
+					if (settings->enableSub && !localInter) subtract(pos);
 					pulse_detected(lastDetectInfo);
 				}
 			};
+	batchCallback = [&] () {
+				std::vector<float>::iterator pos = pulSearch->get_iter();
+				batchPos.push_back(pulSearch->get_pos());
+				batch.insert(batch.end(), pos, pos + settings->pulseSize);
+			};
+	coarseCallback = [&] () {
+				// The first upsampled position passing the search lies at most a
+				// coarse sample before the hit, rounding of the coarse windows
+				// adds one more on either side
+				quint32 first = (coarseSearch->get_pos() - 2)*localMult;
+				std::vector<float>::iterator beg = local_window(first, 3*localMult + settings->pulseSize);
+				pulSearch->search(beg, beg + 3*localMult, first);
+			};
+
+}
 
+void ProcessingThread::collect_pulse (std::vector<float>::iterator begPulse) {
+	std::vector<float> a (begPulse, begPulse + settings->pulseSize);
+	float bl = window_baseline(a.begin(), settings->aSet->processBaselineSamples);
+	for (auto &b: a) b -= bl;
+	setupDetectedPulses.push_back(a);
 }
 
-void ProcessingThread::add_to_spectrum () {
-	if (pulAmpl->get_ampl() > 0.f && pulAmpl->get_ampl() < 0.999f)
-		spectrum[pulAmpl->get_ampl()*spectrum.size()]++;
+void ProcessingThread::add_to_spectrum (float ampl) {
+	if (ampl > 0.f && ampl < 0.999f)
+		spectrum[ampl*spectrum.size()]++;
+}
+
+void ProcessingThread::update_batch () {
+	isBatch = get_process_type() == StandartCircuit && !settings->enableSub &&
+			((settings->dSet->enabled && pulDisc->is_batched()) || pulAmpl->is_batched() || pulTime->is_batched());
+	batch.clear();
+	batchPos.clear();
+	pulSearch->set_callback(isBatch ? batchCallback : callback);
+}
+
+void ProcessingThread::flush_batch () {
+	const quint32 size = settings->pulseSize;
+	quint32 count = batchPos.size();
+	if (count && settings->dSet->enabled) {
+		pulDisc->discriminate_batch(batch.begin(), count, batchAccept);
+		quint32 accepted = 0;
+		for (quint32 i = 0; i < count; ++i) if (batchAccept[i]) {
+			if (accepted != i) {
+				batchPos[accepted] = batchPos[i];
+				std::copy(batch.begin() + i*size, batch.begin() + (i + 1)*size, batch.begin() + accepted*size);
+			}
+			++accepted;
+		}
+		count = accepted;
+	}
+	if (count) {
+		pulAmpl->measure_batch(batch.begin(), count, batchAmpl);
+		pulTime->measure_batch(batch.begin(), count, batchTime);
+	}
+	for (quint32 i = 0; i < count; ++i) {
+		++detectedLastSec;
+		if (isPulseCollect) collect_pulse(batch.begin() + i*size);
+		if (isSpectCollect) add_to_spectrum(batchAmpl[i]);
+
+		lastDetectInfo.pos = batchPos[i];
+		lastDetectInfo.ampl = batchAmpl[i];
+		lastDetectInfo.time = batchTime[i];
+		pulse_detected(lastDetectInfo);
+	}
+	batch.clear();
+	batchPos.clear();
 }
 
 void ProcessingThread::subtract(std::vector<float>::iterator begPulse) {
@@ -595,9 +688,7 @@ void ProcessingThread::subtract(std::vector<float>::iterator begPulse) {
 	if (difff < 0) diff = difff - 0.5f;
 	else diff = difff + 0.5f;
 	if (begPulse + diff < input.end() - settings->pulseSize && begPulse + diff > input.begin())
-		for (quint32 i = 0, ie = settings->pulseSize; i < ie; ++i) {
-			*(begPulse + i + diff) -= settings->shape[i]*lastDetectInfo.ampl/pulShapeInfo.ampl;
-		}
+		kernels.subtract(&*(begPulse + diff), settings->shape.data(), lastDetectInfo.ampl/pulShapeInfo.ampl, settings->pulseSize);
 }
 
 void ProcessingThread::run() {
@@ -628,8 +719,9 @@ void ProcessingThread::set_settings (std::shared_ptr<Settings> s) {
 	pulAmpl->set (settings);
 	pulTime->set (settings);
 
-	pulSearch->set_callback(callback);
+	kernels = PulseKernels::get(settings->pulseSize);
 
+	update_local();
 	update_settings();
 
 	if (settings->shape.size() == settings->pulseSize) {
@@ -639,21 +731,66 @@ void ProcessingThread::set_settings (std::shared_ptr<Settings> s) {
 		pulShapeInfo.ampl = pulAmpl->get_ampl();
 		pulShapeInfo.time = pulTime->get_time();
 	} else if (settings->enableSub) settings->enableSub = false;
+	update_batch();
+}
+
+quint32 ProcessingThread::get_history () const {
+	return localInter ? localBegin + localEnd : settings->pulseSize;
 }
 
-void ProcessingThread::set_input(const std::vector<float> *inp) {
-	if (inp->size() + settings->pulseSize != input.size()) {
-		input = std::vector<float> (inp->size() + settings->pulseSize, 0.f);
+void ProcessingThread::set_input(const std::vector<float> *inp, quint32 dec) {
+	const quint32 history = get_history();
+	decimation = dec;
+	if (inp->size() + history != input.size()) {
+		input = std::vector<float> (inp->size() + history, 0.f);
 	}
-	memcpy(input.data(), input.data() + inp->size(), 4*settings->pulseSize);
-	memcpy(input.data() + settings->pulseSize, inp->data(), 4*inp->size());
+	memcpy(input.data(), input.data() + inp->size(), 4*history);
+	memcpy(input.data() + history, inp->data(), 4*inp->size());
 }
 
 std::vector<float> ProcessingThread::get_processed () const {
-	if (input.size()) return std::vector<float> (input.data() + settings->pulseSize, input.data() + input.size());
+	if (input.size()) return std::vector<float> (input.data() + get_history(), input.data() + input.size());
 	else return std::vector<float> (0);
 }
 
+void ProcessingThread::set_local_interpolator(std::shared_ptr<const Interpolator> inter) {
+	if (inter == localInter && (!inter ||
+		(inter->get_settings().pointsMult == localMult && inter->get_history_size() == localTaps))) return;
+	localInter = inter;
+	update_local();
+	update_settings();
+}
+
+// Coarse positions [localBegin, input.size() - localEnd) are searched, the
+// margins hold the interpolation kernel around the largest window
+void ProcessingThread::update_local() {
+	if (!localInter) {
+		localMult = 1;
+		localTaps = localBegin = localEnd = 0;
+		coarseSearch.reset();
+		coarseSettings.reset();
+		pulSearch->set_single(false);
+		return;
+	}
+	localMult = localInter->get_settings().pointsMult;
+	localTaps = localInter->get_history_size();
+	localBegin = localTaps/2 + 4;
+	localEnd = (settings->pulseSize + localMult - 1)/localMult + localTaps/2 + 4;
+	coarseSettings = Settings::get_copy(*settings);
+	coarseSettings->sSet = PulseSearching::SearchSettings::get_coarse(settings->sSet, localMult);
+	if (!coarseSearch || coarseSearch->get_search_type() != settings->sSet->get_s_settings_id())
+		coarseSearch = PulseSearching::get_new(settings->sSet->get_s_settings_id());
+	coarseSearch->set(coarseSettings);
+	coarseSearch->set_callback(coarseCallback);
+	pulSearch->set_single(true);
+}
+
+std::vector<float>::iterator ProcessingThread::local_window(quint32 first, quint32 count) {
+	local.resize(count);
+	localInter->interpolate_local(input.data(), first, count, local.data());
+	return local.begin();
+}
+
 void ProcessingThread::save (std::ostream& os) const {
 	quint32 t;
 	quint8 c;
@@ -663,7 +800,7 @@ void ProcessingThread::save (std::ostream& os) const {
 	os.write((char*)&(t = settings->shape.size()), 4);
 	os.write((char*)&(f = settings->amplCorrection), 4);
 	os.write((char*)&(t = settings->inputNum), 4);
-	os.write((char*)&(c = settings->enableSub), 1);
+	os.write((char*)&(c = settings->enableSub | (settings->quantizeNN << 1) | (settings->fastActivation << 2)), 1);
 	os.write((char*)settings->shape.data(), 4*settings->shape.size());
 
 	os.write((char*)&(t = name.toUtf8().size()), 4);
@@ -687,6 +824,7 @@ void ProcessingThread::load (std::istream& is) {
 
 	is.read((char*)&t, 4);
 	settings->pulseSize = t;
+	kernels = PulseKernels::get(settings->pulseSize);
 	is.read((char*)&t, 4);
 	settings->shape.resize(t);
 	is.read((char*)&f, 4);
@@ -694,7 +832,9 @@ void ProcessingThread::load (std::istream& is) {
 	is.read((char*)&t, 4);
 	settings->inputNum = t;
 	is.read((char*)&c, 1);
-	settings->enableSub = c;
+	settings->enableSub = c & 1;
+	settings->quantizeNN = c & 2;
+	settings->fastActivation = c & 4;
 	is.read((char*)settings->shape.data(), 4*settings->shape.size());
 
 	is.read((char*)&t, 4);
@@ -766,6 +906,7 @@ void ProcessingThread::load (std::istream& is) {
 	if (settings->tSet->get_t_settings_id() != t) settings->tSet = PulseTimeMeasuring::TimeSettings::get_new(t);
 	pulTime->set(settings);
 	pulTime->load(is);
+	update_batch();
 }
 
 ProcessingStandartCircuit::ProcessingStandartCircuit(quint32 specSize) : ProcessingThread (specSize) {
@@ -783,7 +924,9 @@ ProcessingStandartCircuit::ProcessingStandartCircuit(quint32 specSize) : Process
 }
 
 void ProcessingStandartCircuit::process() {
-	pulSearch->search(input.begin(), input.end() - settings->pulseSize, 0);
+	if (localInter) coarseSearch->search(input.begin() + localBegin, input.end() - localEnd, localBegin);
+	else pulSearch->search(input.begin(), input.end() - settings->pulseSize, 0);
+	if (isBatch) flush_batch();
 }
 
 ProcessingCoincidenceCircuit::ProcessingCoincidenceCircuit(quint32 specSize) : ProcessingThread (specSize) {
@@ -811,23 +954,13 @@ ProcessingCoincidenceCircuit::ProcessingCoincidenceCircuit(quint32 specSize) : P
 					CoinCircuitSettings* tmp = (CoinCircuitSettings*)settings.get();
 					if (timeDiff*timeDiff > tmp->maxTimeDifference*tmp->maxTimeDifference) return;
 
-					if (isPulseCollect) {
-						std::vector<float> a (pos, pos + settings->pulseSize);
-						if (settings->aSet->processBaselineSamples) {
-							float bl = 0.f;
-							for (auto b = a.begin(), be = b + settings->aSet->processBaselineSamples; b != be; ++b)
-								bl += *b;
-							bl /= settings->aSet->processBaselineSamples;
-							for (auto &b: a) b -= bl;
-						}
-						setupDetectedPulses.push_back(a);
-					}
-					if (isSpectCollect) add_to_spectrum();
+					if (isPulseCollect) collect_pulse(pos);
+					if (isSpectCollect) add_to_spectrum(pulAmpl->get_ampl());
 
 					lastDetectInfo.pos = pulSearch->get_pos();
 					lastDetectInfo.ampl = pulAmpl->get_ampl();
 					lastDetectInfo.time = pulTime->get_time();
-					if (settings->enableSub) subtract(pos);
+					if (settings->enableSub && !localInter) subtract(pos);
 					pulse_detected(lastDetectInfo);
 				}
 			};
@@ -856,22 +989,39 @@ void ProcessingCoincidenceCircuit::set_coincidence(ProcessingThread *coincidence
 
 void ProcessingCoincidenceCircuit::detect_event(PulseInfo p) {
 	CoinCircuitSettings* tmp = (CoinCircuitSettings*)settings.get();
-	std::vector<float>::iterator beg, end;
+	std::vector<float>::iterator beg;
 
 	if (p.ampl < tmp->amplitudeIntervalL || p.ampl > tmp->amplitudeIntervalR) return;
 
-	if (p.pos > tmp->maxTimeDifference*2) {
-		beg = input.begin() + (p.pos - tmp->maxTimeDifference*2);
+	// The source stream may be decimated differently and keep a different
+	// history, bring its position (relative to the start of the new data)
+	// to the rate and the buffer of this stream
+	if (coincidenceWith != this) {
+		const double scale = double(coincidenceWith->get_decimation())/decimation;
+		const double pos = (double(p.pos) - double(coincidenceWith->get_history())*localMult)*scale
+						   + double(get_history())*localMult + p.time*scale;
+		if (pos < 0.) return;
+		p.pos = quint32(pos);
+		p.time = float(pos - p.pos);
 	}
-	else beg = input.begin();
-	if (input.begin() + p.pos + 2*tmp->maxTimeDifference + 2*settings->pulseSize < input.end()) {
-		end = input.begin() + (p.pos + tmp->maxTimeDifference*2 + settings->pulseSize);
+
+	if (localInter) {
+		qint64 first = std::max<qint64> (qint64(p.pos) - tmp->maxTimeDifference*2, localBegin*localMult);
+		qint64 last = std::min<qint64> (qint64(p.pos) + tmp->maxTimeDifference*2, qint64(input.size() - localEnd)*localMult);
+		if (first >= last) return;
+		coinPulse = p;
+		beg = local_window(first, last - first + settings->pulseSize);
+		pulSearch->search(beg, beg + (last - first), first);
+		return;
 	}
-	else end = input.end() - settings->pulseSize;
+
+	qint64 first = std::max<qint64> (qint64(p.pos) - tmp->maxTimeDifference*2, 0);
+	qint64 last = std::min<qint64> (qint64(p.pos) + tmp->maxTimeDifference*2 + settings->pulseSize,
+									qint64(input.size()) - settings->pulseSize);
+	if (first >= last) return;
 	coinPulse = p;
-	assert(input.end() - end >= settings->pulseSize);
-	assert(beg - input.begin() >= 0);
-	pulSearch->search(beg, end, beg - input.begin());
+	beg = input.begin() + first;
+	pulSearch->search(beg, input.begin() + last, first);
 }
 
 void ProcessingCoincidenceCircuit::source_deleted() {
@@ -908,9 +1058,16 @@ PulseProcessing::~PulseProcessing() {
 	mutex.unlock();
 }
 
-void PulseProcessing::set_inputs(std::vector<std::vector<float> const*> _inputs) {
+void PulseProcessing::set_inputs(std::vector<std::vector<float> const*> _inputs, std::vector<quint32> _decimations) {
 	mutex.lock();
 	inputs = _inputs;
+	decimations = _decimations;
+	mutex.unlock();
+}
+
+void PulseProcessing::set_local_interpolator(std::shared_ptr<const Interpolator> inter) {
+	mutex.lock();
+	for (auto& a: threads) a->set_local_interpolator(inter);
 	mutex.unlock();
 }
 
@@ -991,7 +1148,10 @@ void PulseProcessing::set_setup_thread(quint32 thread) {
 
 void PulseProcessing::process() {
 	mutex.lock();
-	for (quint32 i = 0, ie = threads.size(); i < ie; ++i) threads[i]->set_input(inputs[threads[i]->get_settings()->inputNum]);
+	for (quint32 i = 0, ie = threads.size(); i < ie; ++i) {
+		const quint32 n = threads[i]->get_settings()->inputNum;
+		threads[i]->set_input(inputs[n], n < decimations.size() ? decimations[n] : 1);
+	}
 	for (quint32 i = 0, ie = threads.size(); i < ie; ++i) threads[i].get()->run();
 	finished();
 	mutex.unlock();
@@ -37,6 +37,9 @@
 #include "Eigen/Core"
 #include "Eigen/LU"
 #include "nuclearphysicsperceptron.hpp"
+#include "quantizedperceptron.hpp"
+#include "pulsekernels.hpp"
+#include "interpolator.hpp"
 
 class PulseSearching;
 class PulseDiscriminator;
@@ -65,11 +68,18 @@ class ProcessingThread : public QObject{
 		std::vector<quint32> const* get_spectrum () const { return &spectrum; }
 		void reset_spectrum () { spectrum = std::vector<quint32> (spectrum.size(), 0); }
 
-		void set_input (std::vector<float> const* inp);
+		// 'dec' is the decimation of the filter stream feeding 'inp', so
+		// positions can be converted between streams of different rates
+		void set_input (std::vector<float> const* inp, quint32 dec = 1);
 		std::vector<float> get_processed () const;
+		quint32 get_decimation () const { return decimation; }
+		quint32 get_history () const;
 
 		void set_settings (std::shared_ptr<Settings> s);
 		Settings const* get_settings () const { return settings.get(); }
+		// Input is at the original rate and only pulse windows are upsampled
+		// by 'inter', nullptr when the input is already interpolated
+		void set_local_interpolator (std::shared_ptr<const Interpolator> inter);
 		void set_name (QString str) { name = str; }
 		QString get_name () const { return name; }
 		virtual quint32 get_process_type () const = 0;
@@ -98,6 +108,7 @@ class ProcessingThread : public QObject{
 		QMutex mutex;
 		std::vector<quint32> spectrum;
 		std::vector<float> input;
+		quint32 decimation = 1;
 		QString name;
 
 		std::shared_ptr<PulseSearching> pulSearch;
@@ -106,6 +117,7 @@ class ProcessingThread : public QObject{
 		std::shared_ptr<PulseTimeMeasuring> pulTime;
 
 		std::shared_ptr<Settings> settings;
+		PulseKernels::Set kernels;
 		PulseInfo pulShapeInfo;
 
 		PulseInfo lastDetectInfo;
@@ -116,14 +128,43 @@ class ProcessingThread : public QObject{
 
 		std::function<void ()> callback;
 
+		// Batch mode: the search only collects pulse windows back to back in
+		// 'batch', flush_batch then runs every stage once over the whole
+		// buffer. Used when a stage is a neural net and subtraction is off.
+		bool isBatch = false;
+		std::vector<float> batch;
+		std::vector<quint32> batchPos;
+		std::vector<quint8> batchAccept;
+		std::vector<float> batchAmpl;
+		std::vector<float> batchTime;
+		std::function<void ()> batchCallback;
+
+		// Local interpolation: coarseSearch runs on the original rate input
+		// with coarseSettings, each hit is confirmed by pulSearch on an
+		// interpolated window. Positions are in upsampled samples.
+		std::shared_ptr<const Interpolator> localInter;
+		quint32 localMult = 1;
+		quint32 localTaps = 0;
+		quint32 localBegin = 0;
+		quint32 localEnd = 0;
+		std::shared_ptr<PulseSearching> coarseSearch;
+		std::shared_ptr<Settings> coarseSettings;
+		std::function<void ()> coarseCallback;
+		std::vector<float> local;
+
 		quint32 detectedLastSec = 0;
 		quint32 countRate = 0;
 
 		virtual void update_settings() = 0;
 		virtual void process() = 0;
 		void subtract (std::vector<float>::iterator begPulse);
+		void update_local ();
+		std::vector<float>::iterator local_window (quint32 first, quint32 count);
+		void update_batch ();
+		void flush_batch ();
 
-		void add_to_spectrum ();
+		void collect_pulse (std::vector<float>::iterator begPulse);
+		void add_to_spectrum (float ampl);
 
 
 };
@@ -282,6 +323,9 @@ class PulseDiscriminator {
 		PulseDiscriminator () {}
 		virtual ~PulseDiscriminator () {}
 		virtual quint8 discriminate (std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse) = 0;
+		// 'count' windows stored back to back from 'begin'
+		virtual void discriminate_batch (std::vector<float>::iterator begin, quint32 count, std::vector<quint8>& result);
+		virtual bool is_batched () const { return false; }
 
 		virtual void save (std::ostream& os) const = 0;
 		virtual void load (std::istream& is) = 0;
@@ -300,6 +344,7 @@ class PulseDiscriminator {
 
 	protected:
 		std::shared_ptr<ProcessingThread::Settings> settings;
+		PulseKernels::Set kernels;
 		virtual void update_settings () = 0;
 
 };
@@ -326,7 +371,12 @@ class PulseDiscriminatorByDispersion : public PulseDiscriminator {
 
 class PulseDiscriminatorByNeuralNet : public PulseDiscriminator {
 
-		void update_settings() {}
+		std::vector<float> nnInput;
+		Eigen::MatrixXf nnBatch;
+		Neural_Network::CompiledPerceptron net;
+		Neural_Network::QuantizedPerceptron qnet;
+
+		void update_settings();
 
 	public:
 
@@ -339,6 +389,8 @@ class PulseDiscriminatorByNeuralNet : public PulseDiscriminator {
 		quint32 get_disc_type() const { return PulseDiscriminator::NeuralNet; }
 
 		quint8 discriminate(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse);
+		void discriminate_batch (std::vector<float>::iterator begin, quint32 count, std::vector<quint8>& result);
+		bool is_batched () const { return true; }
 
 		class DiscNNSettings;
 
@@ -352,7 +404,9 @@ class PulseAmplMeasuring {
 		virtual ~PulseAmplMeasuring() {}
 
 		void measure (std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse);
+		void measure_batch (std::vector<float>::iterator begin, quint32 count, std::vector<float>& ampl);
 		float get_ampl() const { return pulseAmpl; }
+		virtual bool is_batched () const { return false; }
 
 		virtual void save (std::ostream& os) const = 0;
 		virtual void load (std::istream& is) = 0;
@@ -373,7 +427,9 @@ class PulseAmplMeasuring {
 	protected:
 		float pulseAmpl = 0.;
 		std::shared_ptr<ProcessingThread::Settings> settings;
+		PulseKernels::Set kernels;
 		virtual float find_ampl(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse) = 0;
+		virtual void find_ampl_batch(std::vector<float>::iterator begin, quint32 count, float* ampl);
 		virtual void update_settings () = 0;
 
 };
@@ -401,9 +457,7 @@ class PulseAmplMeasuringPolyMax : public PulseAmplMeasuring {
 		float find_ampl(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse);
 		void update_settings();
 
-		std::vector<Eigen::VectorXf*> polyVectors;
-		Eigen::MatrixXf polyMatrix;
-		Eigen::VectorXf polyValues;
+		Eigen::MatrixXf polyProjection;
 		Eigen::VectorXf polyRestoredPulse;
 
 	public:
@@ -421,8 +475,14 @@ class PulseAmplMeasuringPolyMax : public PulseAmplMeasuring {
 
 class PulseAmplMeasuringNeuralNet : public PulseAmplMeasuring {
 
+		std::vector<float> nnInput;
+		Eigen::MatrixXf nnBatch;
+		Neural_Network::CompiledPerceptron net;
+		Neural_Network::QuantizedPerceptron qnet;
+
 		float find_ampl(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse);
-		void update_settings() {}
+		void find_ampl_batch(std::vector<float>::iterator begin, quint32 count, float* ampl);
+		void update_settings();
 
 	public:
 
@@ -433,6 +493,7 @@ class PulseAmplMeasuringNeuralNet : public PulseAmplMeasuring {
 		void load(std::istream &is);
 
 		quint32 get_ampl_type() const { return PulseAmplMeasuring::NeuralNet; }
+		bool is_batched () const { return true; }
 
 		class AmplNNSettings;
 };
@@ -444,7 +505,10 @@ class PulseTimeMeasuring {
 		virtual ~PulseTimeMeasuring () {}
 		void measure (std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse)
 			{ pulseTime = find_time(begPulse, endPulse); }
+		void measure_batch (std::vector<float>::iterator begin, quint32 count, std::vector<float>& time)
+			{ time.resize(count); find_time_batch(begin, count, time.data()); }
 		float get_time() const { return pulseTime; }
+		virtual bool is_batched () const { return false; }
 
 		virtual void save (std::ostream& os) const = 0;
 		virtual void load (std::istream& is) = 0;
@@ -464,8 +528,10 @@ class PulseTimeMeasuring {
 	protected:
 		float pulseTime = 0.;
 		std::shared_ptr<ProcessingThread::Settings> settings;
+		PulseKernels::Set kernels;
 
 		virtual float find_time(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse) = 0;
+		virtual void find_time_batch(std::vector<float>::iterator begin, quint32 count, float* time);
 		virtual void update_settings () = 0;
 
 };
@@ -490,8 +556,14 @@ class PulseTimeMeasuringByMax : public PulseTimeMeasuring {
 
 class PulseTimeMeasuringNeuralNet : public PulseTimeMeasuring {
 
+		std::vector<float> nnInput;
+		Eigen::MatrixXf nnBatch;
+		Neural_Network::CompiledPerceptron net;
+		Neural_Network::QuantizedPerceptron qnet;
+
 		float find_time(std::vector<float>::iterator begPulse, std::vector<float>::iterator endPulse);
-		void update_settings() {}
+		void find_time_batch(std::vector<float>::iterator begin, quint32 count, float* time);
+		void update_settings();
 
 	public:
 
@@ -502,6 +574,7 @@ class PulseTimeMeasuringNeuralNet : public PulseTimeMeasuring {
 		void load(std::istream &is);
 
 		quint32 get_time_type() const { return NeuralNet; }
+		bool is_batched () const { return true; }
 
 		class TimeNNSettings;
 };
@@ -516,13 +589,16 @@ class PulseProcessing : public QObject {
 		quint32 setupStream = 0;
 
 		std::vector<std::vector<float> const*> inputs;
+		std::vector<quint32> decimations;
 
 		void update_settings();
 
 	public:
 		PulseProcessing (quint32 specSize = 0x200);
 		~PulseProcessing();
-		void set_inputs (std::vector<std::vector<float> const*> _inputs);
+		void set_inputs (std::vector<std::vector<float> const*> _inputs,
+						 std::vector<quint32> _decimations = std::vector<quint32> ());
+		void set_local_interpolator (std::shared_ptr<const Interpolator> inter);
 		std::vector<float> get_processed (quint32 index) const
 			{ return threads[index]->get_processed(); }
 		void set_settings (std::shared_ptr<ProcessingThread::Settings> set, quint32 index);
@@ -56,6 +56,16 @@ ProcessingDialog::ProcessingDialog (Core* ptr, QWidget* parent) : QDialog (paren
 	amplCorrectionDSB->setDecimals(4);
 	subtractL = new QLabel (tr("Subtract shape from detected pulse"), this);
 	subtractCB = new QCheckBox(this);
+	quantizeL = new QLabel (tr("Int8 neural network inference"), this);
+	quantizeCB = new QCheckBox(this);
+	fastActivationL = new QLabel (tr("Fast neural network activation functions"), this);
+	fastActivationCB = new QCheckBox(this);
+	rateL = new QLabel (this);
+	rateL->setWordWrap(true);
+	if (!Neural_Network::QuantizedPerceptron::is_supported()) {
+		quantizeL->setEnabled(false);
+		quantizeCB->setEnabled(false);
+	}
 
 	pulseSizeCB->addItem("8", QVariant(0x8));
 	pulseSizeCB->addItem("16", QVariant(0x10));
@@ -108,6 +118,9 @@ ProcessingDialog::ProcessingDialog (Core* ptr, QWidget* parent) : QDialog (paren
 		a->setModal(true);
 		connect(a, SIGNAL(accepted()), this, SLOT(settings_accepted()));
 	}
+	for (auto& a: specDialogs) {
+		connect(a, SIGNAL(accepted()), this, SLOT(settings_accepted()));
+	}
 
 
 	thrdLayout = new QHBoxLayout;
@@ -154,6 +167,11 @@ ProcessingDialog::ProcessingDialog (Core* ptr, QWidget* parent) : QDialog (paren
 	widgLayout->addWidget(amplCorrectionDSB, 8, 2, 1, 1);
 	widgLayout->addWidget(subtractL, 9, 0, 1, 2);
 	widgLayout->addWidget(subtractCB, 9, 2, 1, 1);
+	widgLayout->addWidget(quantizeL, 10, 0, 1, 2);
+	widgLayout->addWidget(quantizeCB, 10, 2, 1, 1);
+	widgLayout->addWidget(fastActivationL, 11, 0, 1, 2);
+	widgLayout->addWidget(fastActivationCB, 11, 2, 1, 1);
+	widgLayout->addWidget(rateL, 12, 0, 1, 3);
 	butnLayout->addWidget(startPB);
 	butnLayout->addWidget(capturePB);
 	butnLayout->addWidget(applyPB);
@@ -230,6 +248,10 @@ void ProcessingDialog::load_to_dial_settings(int index) {
 void ProcessingDialog::update_sub_widgets() {
 	if (curSettings[threadsCB->currentIndex()]->enableSub) subtractCB->setCheckState(Qt::Checked);
 	else subtractCB->setCheckState(Qt::Unchecked);
+	if (curSettings[threadsCB->currentIndex()]->quantizeNN) quantizeCB->setCheckState(Qt::Checked);
+	else quantizeCB->setCheckState(Qt::Unchecked);
+	if (curSettings[threadsCB->currentIndex()]->fastActivation) fastActivationCB->setCheckState(Qt::Checked);
+	else fastActivationCB->setCheckState(Qt::Unchecked);
 	if (curSettings[threadsCB->currentIndex()]->shape.size() == curSettings[threadsCB->currentIndex()]->pulseSize) {
 		subtractL->setEnabled(true);
 		subtractCB->setEnabled(true);
@@ -239,6 +261,20 @@ void ProcessingDialog::update_sub_widgets() {
 	}
 }
 
+// Sample counts of the settings are at the rate of the input stream,
+// which is lower than the device rate behind a decimator
+void ProcessingDialog::update_rate() {
+	quint32 input = curSettings[threadsCB->currentIndex()]->inputNum;
+	if (input >= corePtr->get_input_streams()) {
+		rateL->clear();
+		return;
+	}
+	quint32 rate = corePtr->get_effective_sample_rate(input);
+	if (rate == corePtr->get_sample_rate())
+		rateL->setText(tr("Input stream rate %1 Hz").arg(rate));
+	else rateL->setText(tr("Input stream is decimated to %1 Hz, all sample counts are at this rate").arg(rate));
+}
+
 void ProcessingDialog::set_spec_dial() {
 	specDialogs[curSettings[threadsCB->currentIndex()]->get_settings_id()]->set_current_thread(threadsCB->currentIndex());
 	specPB->setProperty("", QVariant(curSettings[threadsCB->currentIndex()]->get_settings_id()));
@@ -284,6 +320,7 @@ void ProcessingDialog::thread_changed() {
 	load_to_dial_settings(threadsCB->currentIndex());
 	update_sub_widgets();
 	set_spec_dial();
+	update_rate();
 
 	connect (pulseSizeCB, SIGNAL(currentIndexChanged(int)), this, SLOT(size_changed()));
 	connect (pulseSearchCB, SIGNAL(currentIndexChanged(int)), this, SLOT(method_changed()));
@@ -329,6 +366,7 @@ void ProcessingDialog::method_changed() {
 }
 
 void ProcessingDialog::settings_accepted() {
+	update_rate();
 	bool success = check_settings();
 	applyPB->setEnabled(success);
 	acceptPB->setEnabled(success);
@@ -390,6 +428,10 @@ void ProcessingDialog::apply() {
 	curSettings[threadsCB->currentIndex()]->amplCorrection = amplCorrectionDSB->value();
 	if (subtractCB->checkState() == Qt::Checked) curSettings[threadsCB->currentIndex()]->enableSub = true;
 	else curSettings[threadsCB->currentIndex()]->enableSub = false;
+	if (quantizeCB->checkState() == Qt::Checked) curSettings[threadsCB->currentIndex()]->quantizeNN = true;
+	else curSettings[threadsCB->currentIndex()]->quantizeNN = false;
+	if (fastActivationCB->checkState() == Qt::Checked) curSettings[threadsCB->currentIndex()]->fastActivation = true;
+	else curSettings[threadsCB->currentIndex()]->fastActivation = false;
 
 	if (curSettings[threadsCB->currentIndex()]->pulseSize != curSettings[threadsCB->currentIndex()]->shape.size()
 		&& curSettings[threadsCB->currentIndex()]->shape.size()) curSettings[threadsCB->currentIndex()]->shape.resize(curSettings[threadsCB->currentIndex()]->pulseSize, 0.f);
@@ -69,6 +69,11 @@ class ProcessingDialog : public QDialog {
 		QDoubleSpinBox* amplCorrectionDSB;
 		QLabel* subtractL;
 		QCheckBox* subtractCB;
+		QLabel* quantizeL;
+		QCheckBox* quantizeCB;
+		QLabel* fastActivationL;
+		QCheckBox* fastActivationCB;
+		QLabel* rateL;
 
 		QHBoxLayout* thrdLayout;
 		QGridLayout* widgLayout;
@@ -104,6 +109,7 @@ class ProcessingDialog : public QDialog {
 		void load_to_dial_settings(int index);
 		void update_sub_widgets();
 		void set_spec_dial();
+		void update_rate();
 		bool check_settings();
 
 	public:
@@ -37,6 +37,8 @@ ProcessingThread::Settings::Settings (const Settings &s) {
 	pulseSize = s.pulseSize;
 	amplCorrection = s.amplCorrection;
 	enableSub = s.enableSub;
+	quantizeNN = s.quantizeNN;
+	fastActivation = s.fastActivation;
 }
 
 ProcessingThread::Settings& ProcessingThread::Settings::operator = (const ProcessingThread::Settings& s) {
@@ -49,6 +51,8 @@ ProcessingThread::Settings& ProcessingThread::Settings::operator = (const Proces
 	amplCorrection = s.amplCorrection;
 	inputNum = s.inputNum;
 	enableSub = s.enableSub;
+	quantizeNN = s.quantizeNN;
+	fastActivation = s.fastActivation;
 	return *this;
 }
 
@@ -103,6 +107,39 @@ std::shared_ptr<PulseSearching::SearchSettings> PulseSearching::SearchSettings::
 	}
 }
 
+// Sample counts are divided by the factor, slopes multiplied by it. Windows
+// are kept wide enough for the fits of TanThreshold.
+std::shared_ptr<PulseSearching::SearchSettings> PulseSearching::SearchSettings::get_coarse(const std::shared_ptr<SearchSettings> &search, quint32 factor) {
+	std::shared_ptr<SearchSettings> coarse = get_copy(search);
+	coarse->skipSamples /= factor;
+	switch (search->get_s_settings_id()) {
+		case PulseSearching::Threshold: {
+			PulseSearchingThreshold::SearchThresholdSettings* tmp = (PulseSearchingThreshold::SearchThresholdSettings*)coarse.get();
+			quint32 detect = (tmp->detectBaselineSamples + tmp->detectPos + factor/2)/factor;
+			if (tmp->detectBaselineSamples) tmp->detectBaselineSamples = std::max(tmp->detectBaselineSamples/factor, 1u);
+			tmp->detectPos = detect > tmp->detectBaselineSamples ? detect - tmp->detectBaselineSamples : 0;
+			break;
+		} case PulseSearching::Monoton: {
+			PulseSearchingMonoton::SearchMonotonSettings* tmp = (PulseSearchingMonoton::SearchMonotonSettings*)coarse.get();
+			tmp->risingSamples = std::max(tmp->risingSamples/factor, 1u);
+			tmp->indiffSamples = (tmp->indiffSamples + factor/2)/factor;
+			if (tmp->fallingSamples) tmp->fallingSamples = std::max(tmp->fallingSamples/factor, 1u);
+			break;
+		} case PulseSearching::TanThreshold: {
+			PulseSearchingTanThreshold::SearchTanThresholdSettings* tmp = (PulseSearchingTanThreshold::SearchTanThresholdSettings*)coarse.get();
+			tmp->risingSamples = std::max(tmp->risingSamples/factor, 2u);
+			tmp->indiffSamples = (tmp->indiffSamples + factor/2)/factor;
+			if (tmp->fallingSamples) tmp->fallingSamples = std::max(tmp->fallingSamples/factor, 2u);
+			tmp->risingTan *= factor;
+			tmp->fallingTan *= factor;
+			break;
+		} default:
+			assert(false);
+			break;
+	}
+	return coarse;
+}
+
 std::shared_ptr<PulseSearching::SearchSettings> PulseSearching::SearchSettings::get_new(quint32 num) {
 	switch (num) {
 		case PulseSearching::Threshold:
@@ -41,6 +41,10 @@ class ProcessingThread::Settings {
 		float amplCorrection = 1.f;
 		quint32 inputNum = 0;
 		bool enableSub = false;
+		// Int8 inference of the NN stages in batch mode, see QuantizedPerceptron
+		bool quantizeNN = false;
+		// Bounded-error activation approximations in the NN stages
+		bool fastActivation = false;
 		virtual quint32 get_settings_id () const = 0;
 };
 
@@ -71,6 +75,8 @@ class PulseSearching::SearchSettings {
 		quint32 virtual get_s_settings_id() const = 0;
 		static std::shared_ptr<SearchSettings> get_copy (const std::shared_ptr<SearchSettings>& search);
 		static std::shared_ptr<SearchSettings> get_new (quint32 num);
+		// Copy for data decimated by 'factor', used as a coarse pre-search
+		static std::shared_ptr<SearchSettings> get_coarse (const std::shared_ptr<SearchSettings>& search, quint32 factor);
 };
 
 class PulseSearchingThreshold::SearchThresholdSettings : public SearchSettings {
@@ -0,0 +1,97 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef PULSEKERNELS_HPP
+#define PULSEKERNELS_HPP
+
+#include <QtGlobal>
+#include "Eigen/Core"
+
+// Per-pulse kernels. Template parameter is the pulse window length,
+// 0 means the length is taken from the 'size' argument at run time.
+
+namespace PulseKernels {
+
+template <quint32 N> float dispersion (const float* pulse, const float* shape, quint32 size) {
+	const quint32 n = N ? N : size;
+	float tDisp = 0.f;
+	for (quint32 i = 0; i < n; ++i) {
+		float fTmp = pulse[i] - shape[i];
+		tDisp += fTmp*fTmp;
+	}
+	return tDisp;
+}
+
+template <quint32 N> float window_max (const float* pulse, quint32 size) {
+	const quint32 n = N ? N : size;
+	float maxVal = pulse[0];
+	for (quint32 i = 1; i < n; ++i) maxVal = pulse[i] > maxVal ? pulse[i] : maxVal;
+	return maxVal;
+}
+
+template <quint32 N> float normalize (const float* pulse, float* out, float bl, quint32 size) {
+	const quint32 n = N ? N : size;
+	float maxVal = window_max<N> (pulse, size);
+	for (quint32 i = 0; i < n; ++i) out[i] = (pulse[i] - bl) / maxVal;
+	return maxVal;
+}
+
+template <quint32 N> void project (const Eigen::MatrixXf& proj, const float* pulse, Eigen::VectorXf& out) {
+	typedef Eigen::Matrix<float, Eigen::Dynamic, N ? (int)N : Eigen::Dynamic> ProjType;
+	typedef Eigen::Matrix<float, N ? (int)N : Eigen::Dynamic, 1> PulseType;
+	out.noalias() = Eigen::Map<const ProjType> (proj.data(), proj.rows(), proj.cols())
+					* Eigen::Map<const PulseType> (pulse, proj.cols());
+}
+
+template <quint32 N> void subtract (float* pulse, const float* shape, float mult, quint32 size) {
+	const quint32 n = N ? N : size;
+	for (quint32 i = 0; i < n; ++i) pulse[i] -= shape[i]*mult;
+}
+
+struct Set {
+	float (*dispersion) (const float*, const float*, quint32);
+	float (*normalize) (const float*, float*, float, quint32);
+	void (*project) (const Eigen::MatrixXf&, const float*, Eigen::VectorXf&);
+	void (*subtract) (float*, const float*, float, quint32);
+};
+
+template <quint32 N> Set make_set () {
+	Set s;
+	s.dispersion = &dispersion<N>;
+	s.normalize = &normalize<N>;
+	s.project = &project<N>;
+	s.subtract = &subtract<N>;
+	return s;
+}
+
+inline Set get (quint32 pulseSize) {
+	switch (pulseSize) {
+		case 16: return make_set<16>();
+		case 32: return make_set<32>();
+		case 64: return make_set<64>();
+		case 128: return make_set<128>();
+		default: return make_set<0>();
+	}
+}
+
+}
+
+#endif // PULSEKERNELS_HPP
@@ -0,0 +1,271 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "quantizedperceptron.hpp"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUANTIZED_X86_SIMD
+#include <immintrin.h>
+#include <cpuid.h>
+#if !defined(__clang__) && __GNUC__ >= 11
+#define QUANTIZED_AVXVNNI
+#endif
+#endif
+
+namespace Neural_Network {
+
+// Layer kernel: out[n] = scale*sum_k w[n*stride + k]*x[k] + bias[n] for int8
+// rows padded with zeros to 'stride', a multiple of 32. The u8 x s8 multiply
+// instructions take |w| as the unsigned operand and x with the sign of w as
+// the signed one; all values are in [-127, 127], so the pair sums of maddubs
+// can not saturate. Eight neurons are accumulated at once and reduced
+// together with hadd.
+
+typedef void (*DotFunc) (const qint8*, const qint8*, const qint8*, quint32, quint32, float, const float*, float*);
+typedef void (*QuantizeFunc) (const float*, quint32, float, qint8*);
+
+struct Kernels {
+	DotFunc dot;
+	QuantizeFunc quantize;
+};
+
+#ifdef QUANTIZED_X86_SIMD
+__attribute__((target("avx2")))
+static inline __m256i reduce8 (const __m256i* acc) {
+	__m256i s0 = _mm256_hadd_epi32(_mm256_hadd_epi32(acc[0], acc[1]), _mm256_hadd_epi32(acc[2], acc[3]));
+	__m256i s1 = _mm256_hadd_epi32(_mm256_hadd_epi32(acc[4], acc[5]), _mm256_hadd_epi32(acc[6], acc[7]));
+	return _mm256_add_epi32(_mm256_permute2x128_si256(s0, s1, 0x20), _mm256_permute2x128_si256(s0, s1, 0x31));
+}
+
+__attribute__((target("avx2")))
+static inline qint32 hsum_epi32 (__m256i v) {
+	__m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load_signed (const qint8* x, const qint8* w) {
+	return _mm256_sign_epi8(_mm256_loadu_si256((const __m256i*)x), _mm256_loadu_si256((const __m256i*)w));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i dot_pairs (__m256i acc, const qint8* absW, __m256i xs) {
+	__m256i p = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)absW), xs);
+	return _mm256_add_epi32(acc, _mm256_madd_epi16(p, _mm256_set1_epi16(1)));
+}
+
+__attribute__((target("avx2,fma")))
+static void dot_avx2 (const qint8* absW, const qint8* w, const qint8* x, quint32 neurons, quint32 stride, float scale, const float* bias, float* out) {
+	quint32 n = 0;
+	for (; n + 8 <= neurons; n += 8) {
+		__m256i acc[8];
+		for (quint32 j = 0; j < 8; ++j) acc[j] = _mm256_setzero_si256();
+		for (quint32 k = 0; k < stride; k += 32)
+			for (quint32 j = 0; j < 8; ++j) {
+				const quint32 o = (n + j)*stride + k;
+				acc[j] = dot_pairs(acc[j], absW + o, load_signed(x + k, w + o));
+			}
+		_mm256_storeu_ps(out + n, _mm256_fmadd_ps(_mm256_cvtepi32_ps(reduce8(acc)), _mm256_set1_ps(scale), _mm256_loadu_ps(bias + n)));
+	}
+	for (; n < neurons; ++n) {
+		__m256i acc = _mm256_setzero_si256();
+		for (quint32 k = 0; k < stride; k += 32) acc = dot_pairs(acc, absW + n*stride + k, load_signed(x + k, w + n*stride + k));
+		out[n] = hsum_epi32(acc)*scale + bias[n];
+	}
+}
+
+__attribute__((target("avx512vnni,avx512vl,fma")))
+static void dot_avx512vnni (const qint8* absW, const qint8* w, const qint8* x, quint32 neurons, quint32 stride, float scale, const float* bias, float* out) {
+	quint32 n = 0;
+	for (; n + 8 <= neurons; n += 8) {
+		__m256i acc[8];
+		for (quint32 j = 0; j < 8; ++j) acc[j] = _mm256_setzero_si256();
+		for (quint32 k = 0; k < stride; k += 32)
+			for (quint32 j = 0; j < 8; ++j) {
+				const quint32 o = (n + j)*stride + k;
+				acc[j] = _mm256_dpbusd_epi32(acc[j], _mm256_loadu_si256((const __m256i*)(absW + o)), load_signed(x + k, w + o));
+			}
+		_mm256_storeu_ps(out + n, _mm256_fmadd_ps(_mm256_cvtepi32_ps(reduce8(acc)), _mm256_set1_ps(scale), _mm256_loadu_ps(bias + n)));
+	}
+	for (; n < neurons; ++n) {
+		__m256i acc = _mm256_setzero_si256();
+		for (quint32 k = 0; k < stride; k += 32)
+			acc = _mm256_dpbusd_epi32(acc, _mm256_loadu_si256((const __m256i*)(absW + n*stride + k)), load_signed(x + k, w + n*stride + k));
+		out[n] = hsum_epi32(acc)*scale + bias[n];
+	}
+}
+
+#ifdef QUANTIZED_AVXVNNI
+__attribute__((target("avxvnni,fma")))
+static void dot_avxvnni (const qint8* absW, const qint8* w, const qint8* x, quint32 neurons, quint32 stride, float scale, const float* bias, float* out) {
+	quint32 n = 0;
+	for (; n + 8 <= neurons; n += 8) {
+		__m256i acc[8];
+		for (quint32 j = 0; j < 8; ++j) acc[j] = _mm256_setzero_si256();
+		for (quint32 k = 0; k < stride; k += 32)
+			for (quint32 j = 0; j < 8; ++j) {
+				const quint32 o = (n + j)*stride + k;
+				acc[j] = _mm256_dpbusd_avx_epi32(acc[j], _mm256_loadu_si256((const __m256i*)(absW + o)), load_signed(x + k, w + o));
+			}
+		_mm256_storeu_ps(out + n, _mm256_fmadd_ps(_mm256_cvtepi32_ps(reduce8(acc)), _mm256_set1_ps(scale), _mm256_loadu_ps(bias + n)));
+	}
+	for (; n < neurons; ++n) {
+		__m256i acc = _mm256_setzero_si256();
+		for (quint32 k = 0; k < stride; k += 32)
+			acc = _mm256_dpbusd_avx_epi32(acc, _mm256_loadu_si256((const __m256i*)(absW + n*stride + k)), load_signed(x + k, w + n*stride + k));
+		out[n] = hsum_epi32(acc)*scale + bias[n];
+	}
+}
+#endif
+
+// x[i]*scale rounded to nearest and clamped to [-127, 127]
+__attribute__((target("avx2")))
+static void quantize_avx2 (const float* in, quint32 count, float scale, qint8* out) {
+	const __m256 s = _mm256_set1_ps(scale), lo = _mm256_set1_ps(-127.f), hi = _mm256_set1_ps(127.f);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	quint32 i = 0;
+	for (; i + 32 <= count; i += 32) {
+		__m256i q[4];
+		for (quint32 j = 0; j < 4; ++j)
+			q[j] = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8*j), s), lo), hi));
+		// packs works within 128 bit lanes, the permutation restores the order
+		__m256i p = _mm256_packs_epi16(_mm256_packs_epi32(q[0], q[1]), _mm256_packs_epi32(q[2], q[3]));
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_permutevar8x32_epi32(p, order));
+	}
+	for (; i < count; ++i) out[i] = std::max(-127l, std::min(127l, std::lrint(in[i]*scale)));
+}
+#endif
+
+static Kernels select_kernels () {
+	Kernels k = {nullptr, nullptr};
+#ifdef QUANTIZED_X86_SIMD
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma")) return k;
+	k.quantize = &quantize_avx2;
+	k.dot = &dot_avx2;
+#ifdef QUANTIZED_AVXVNNI
+	// AVX-VNNI is CPUID leaf 7, subleaf 1, EAX bit 4
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx) && (eax & (1u << 4))) k.dot = &dot_avxvnni;
+#endif
+	if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl")) k.dot = &dot_avx512vnni;
+#endif
+	return k;
+}
+
+static const Kernels kernels = select_kernels();
+
+bool QuantizedPerceptron::is_supported() {
+	return kernels.dot != nullptr;
+}
+
+void QuantizedPerceptron::set(CompiledPerceptron *_net, bool enable, float _tolerance, quint32 calibration) {
+	net = _net;
+	tolerance = _tolerance;
+	calibSamples = calibration;
+	calibFilled = 0;
+	maxError = 0.f;
+	layersVec.clear();
+	if (enable && is_supported() && !net->is_empty()) {
+		state = Calibrating;
+		calibData.resize(net->inputs(), calibSamples);
+	} else {
+		state = Disabled;
+		calibData.resize(0, 0);
+	}
+}
+
+static float quant_scale (float maxAbs) {
+	return maxAbs > 0.f ? maxAbs/127.f : 1.f;
+}
+
+bool QuantizedPerceptron::quantize(const Eigen::MatrixXf &_samples) {
+	assert(net && !net->is_empty() && _samples.rows() == net->inputs());
+	layersVec.clear();
+	if (!is_supported()) {
+		state = Disabled;
+		return false;
+	}
+	const Eigen::MatrixXf reference = net->work_batch(_samples);
+	layersVec.resize(net->layers());
+	for (quint32 l = 0; l < net->layers(); ++l) {
+		const CompiledPerceptron::WeightMatrix& w = net->get_weights(l);
+		const Eigen::MatrixXf& in = l ? net->get_batch_output(l-1) : _samples;
+		Layer& layer = layersVec[l];
+		layer.neurons = w.rows();
+		layer.inputs = w.cols();
+		layer.stride = (layer.inputs + 31)/32*32;
+		layer.weightScale = quant_scale(w.cwiseAbs().maxCoeff());
+		layer.inputScale = quant_scale(in.cwiseAbs().maxCoeff());
+		layer.weights.assign(layer.neurons*layer.stride, 0);
+		layer.absWeights.assign(layer.neurons*layer.stride, 0);
+		for (quint32 n = 0; n < layer.neurons; ++n) for (quint32 k = 0; k < layer.inputs; ++k) {
+			qint32 q = std::max(-127l, std::min(127l, std::lround(w(n, k)/layer.weightScale)));
+			layer.weights[n*layer.stride + k] = q;
+			layer.absWeights[n*layer.stride + k] = std::abs(q);
+		}
+	}
+	maxError = (evaluate(_samples) - reference).cwiseAbs().maxCoeff();
+	state = maxError <= tolerance ? Active : Rejected;
+	return state == Active;
+}
+
+const Eigen::MatrixXf& QuantizedPerceptron::evaluate(const Eigen::MatrixXf &_input) {
+	const quint32 samples = _input.cols();
+	batchVec.resize(layersVec.size());
+	for (quint32 l = 0; l < layersVec.size(); ++l) {
+		const Layer& layer = layersVec[l];
+		const Eigen::MatrixXf& in = l ? batchVec[l-1] : _input;
+		const float scale = layer.weightScale*layer.inputScale;
+		const float* bias = net->get_bias(l).data();
+		Eigen::MatrixXf& out = batchVec[l];
+		out.resize(layer.neurons, samples);
+		quantInput.assign(layer.stride, 0);
+		for (quint32 b = 0; b < samples; ++b) {
+			kernels.quantize(in.col(b).data(), layer.inputs, 1.f/layer.inputScale, quantInput.data());
+			kernels.dot(layer.absWeights.data(), layer.weights.data(), quantInput.data(), layer.neurons, layer.stride, scale, bias, out.col(b).data());
+		}
+		net->activate(l, out);
+	}
+	return batchVec.back();
+}
+
+const Eigen::MatrixXf& QuantizedPerceptron::work_batch(const Eigen::MatrixXf &_input) {
+	switch (state) {
+		case Active:
+			return evaluate(_input);
+		case Calibrating: {
+			const quint32 take = std::min<quint32> (_input.cols(), calibSamples - calibFilled);
+			calibData.middleCols(calibFilled, take) = _input.leftCols(take);
+			calibFilled += take;
+			if (calibFilled == calibSamples) {
+				quantize(calibData);
+				calibData.resize(0, 0);
+			}
+			return net->work_batch(_input);
+		}
+		default:
+			return net->work_batch(_input);
+	}
+}
+
+}
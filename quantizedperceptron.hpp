@@ -0,0 +1,93 @@
+/*
+
+	Copyright (C) 2019 Gostev Roman
+
+	This file is part of SimpleDPP.
+
+	SimpleDPP is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	SimpleDPP is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with SimpleDPP.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef QUANTIZEDPERCEPTRON_HPP
+#define QUANTIZEDPERCEPTRON_HPP
+
+#include "compiledperceptron.hpp"
+
+namespace Neural_Network {
+
+// Int8 inference for a CompiledPerceptron. Weights of every layer are
+// quantized symmetrically to [-127, 127] with one scale per layer, layer
+// inputs with a per-layer scale calibrated from the largest value seen on
+// recorded samples. Dot products are accumulated in int32 by an AVX2 or
+// VNNI kernel, bias and activation stay in float.
+//
+// The quantized net is only used if it reproduces the float outputs on the
+// calibration samples within 'tolerance', otherwise (and on CPUs without
+// AVX2) work_batch evaluates the float net.
+
+class QuantizedPerceptron {
+
+	public:
+
+		enum States {
+			Disabled,
+			Calibrating,
+			Active,
+			Rejected
+		};
+
+	private:
+
+		struct Layer {
+			std::vector<qint8> weights;
+			std::vector<qint8> absWeights;
+			quint32 neurons;
+			quint32 inputs;
+			quint32 stride;
+			float weightScale;
+			float inputScale;
+		};
+
+		CompiledPerceptron* net = nullptr;
+		std::vector<Layer> layersVec;
+		std::vector<qint8> quantInput;
+		std::vector<Eigen::MatrixXf> batchVec;
+		Eigen::MatrixXf calibData;
+		quint32 calibFilled = 0;
+		quint32 calibSamples = 2048;
+		float tolerance = 0.f;
+		float maxError = 0.f;
+		quint32 state = Disabled;
+
+		const Eigen::MatrixXf& evaluate (const Eigen::MatrixXf& _input);
+
+	public:
+
+		QuantizedPerceptron() {}
+		// '_net' has to outlive this object, 'calibration' samples are taken
+		// from the first work_batch calls
+		void set (CompiledPerceptron* _net, bool enable, float _tolerance, quint32 calibration = 2048);
+		// Quantizes with scales taken from '_samples' (one per column) and checks
+		// the result against the float net, returns true if it is accepted
+		bool quantize (const Eigen::MatrixXf& _samples);
+		const Eigen::MatrixXf& work_batch (const Eigen::MatrixXf& _input);
+		quint32 get_state () const { return state; }
+		// Largest output deviation from the float net on the calibration samples
+		float get_error () const { return maxError; }
+		static bool is_supported ();
+};
+
+}
+
+#endif // QUANTIZEDPERCEPTRON_HPP
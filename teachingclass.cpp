@@ -20,19 +20,106 @@
 */
 
 #include "teachingclass.hpp"
+#include "minibatchtrainer.hpp"
+#include "Eigen/Core"
 
 namespace Neural_Network {
 
 static std::uniform_real_distribution<float> randEvent (0.f, 1.f);
 
-void TeachingClass::get_error() {
+void TeachingClass::cache_inputs() {
+	const size_t samples = teachData.size();
+	const quint32 inputs = currentPerceptron->inputs(), layers = currentPerceptron->layers();
+	cachedInputs.resize(samples*inputs);
+	for (size_t i = 0; i < samples; ++i) for (quint32 w = 0; w < inputs; ++w) cachedInputs[w*samples + i] = teachData.input(i)[w];
+	cachedSums.resize(layers);
+	cachedOutputs.resize(layers);
+	cachedBackup.resize(layers);
+	for (quint32 l = 0; l < layers; ++l) {
+		cachedSums[l].resize(samples*currentPerceptron->neurons(l));
+		cachedOutputs[l].resize(samples*currentPerceptron->neurons(l));
+	}
+}
+
+const float* TeachingClass::cached_input(quint32 l, quint32 w) const {
+	if (l) return cachedOutputs[l-1].data() + w*teachData.size();
+	else return cachedInputs.data() + w*teachData.size();
+}
+
+void TeachingClass::activate_neuron(quint32 l, quint32 n) {
+	const size_t samples = teachData.size();
+	const quint32 id = currentPerceptron->get_func_id(l, n);
+	const float* sum = cachedSums[l].data() + n*samples;
+	float* out = cachedOutputs[l].data() + n*samples;
+	for (size_t i = 0; i < samples; ++i) out[i] = activation_value(id, sum[i]);
+}
+
+// Sums in the order of neuron_base::calculate, so the cache holds exactly what
+// Perceptron::work gives for every sample
+void TeachingClass::forward_neuron(quint32 l, quint32 n) {
+	const size_t samples = teachData.size();
+	const std::vector<float>& weights = currentPerceptron->get_weights(l, n);
+	Eigen::Map<Eigen::ArrayXf> sum (cachedSums[l].data() + n*samples, samples);
+	sum.setConstant(currentPerceptron->get_const(l, n));
+	for (quint32 w = 0; w < weights.size(); ++w) sum += Eigen::Map<const Eigen::ArrayXf> (cached_input(l, w), samples) * weights[w];
+	activate_neuron(l, n);
+}
+
+void TeachingClass::cached_error() {
+	const size_t samples = teachData.size();
+	const float* out = cachedOutputs.back().data();
 	double dtmp (.0);
-	std::vector<float> errorVec;
-	for (quint32 i = 0; i < teachData.size(); ++i) {
-		errorVec = currentPerceptron->get_error(teachData[i].first, teachData[i].second);
-		for (quint32 n = 0; n < teachingWeights.size(); ++n) dtmp += errorVec[n] * errorVec[n] * teachingWeights[n];
+	for (size_t i = 0; i < samples; ++i) for (quint32 n = 0; n < teachingWeights.size(); ++n) {
+		float error = teachData.target(i)[n] - out[n*samples + i];
+		dtmp += error * error * teachingWeights[n];
+	}
+	currentResult = std::sqrt(dtmp/samples);
+}
+
+void TeachingClass::get_error() {
+	for (quint32 l = 0; l < currentPerceptron->layers(); ++l)
+		for (quint32 n = 0; n < currentPerceptron->neurons(l); ++n) forward_neuron(l, n);
+	cached_error();
+}
+
+// Error after weight 'w' and the constant of neuron 'n' in layer 'l' were
+// drifted by 'dweight' and 'dcon'. The neuron sum takes a rank-1 update, the
+// next layer sums another one with the change of the neuron output, and only
+// the layers after that are recomputed. restore_cache undoes the update.
+void TeachingClass::get_error(quint32 l, quint32 n, quint32 w, float dweight, float dcon) {
+	const size_t samples = teachData.size();
+	const quint32 layers = currentPerceptron->layers();
+	float* sum = cachedSums[l].data() + n*samples;
+	float* out = cachedOutputs[l].data() + n*samples;
+	cachedBackup[l].assign(sum, sum + samples);
+	cachedBackup[l].insert(cachedBackup[l].end(), out, out + samples);
+	for (quint32 k = l + 1; k < layers; ++k) {
+		cachedBackup[k] = cachedSums[k];
+		cachedBackup[k].insert(cachedBackup[k].end(), cachedOutputs[k].begin(), cachedOutputs[k].end());
+	}
+	Eigen::Map<Eigen::ArrayXf> (sum, samples) += dweight * Eigen::Map<const Eigen::ArrayXf> (cached_input(l, w), samples) + dcon;
+	activate_neuron(l, n);
+	if (l + 1 < layers) {
+		const Eigen::ArrayXf diff = Eigen::Map<const Eigen::ArrayXf> (out, samples) - Eigen::Map<const Eigen::ArrayXf> (cachedBackup[l].data() + samples, samples);
+		for (quint32 m = 0; m < currentPerceptron->neurons(l+1); ++m) {
+			Eigen::Map<Eigen::ArrayXf> (cachedSums[l+1].data() + m*samples, samples) += currentPerceptron->get_weights(l+1, m)[n] * diff;
+			activate_neuron(l+1, m);
+		}
+		for (quint32 k = l + 2; k < layers; ++k)
+			for (quint32 m = 0; m < currentPerceptron->neurons(k); ++m) forward_neuron(k, m);
+	}
+	cached_error();
+}
+
+void TeachingClass::restore_cache(quint32 l, quint32 n) {
+	const size_t samples = teachData.size();
+	memcpy(cachedSums[l].data() + n*samples, cachedBackup[l].data(), 4*samples);
+	memcpy(cachedOutputs[l].data() + n*samples, cachedBackup[l].data() + samples, 4*samples);
+	for (quint32 k = l + 1; k < currentPerceptron->layers(); ++k) {
+		const size_t size = cachedSums[k].size();
+		memcpy(cachedSums[k].data(), cachedBackup[k].data(), 4*size);
+		memcpy(cachedOutputs[k].data(), cachedBackup[k].data() + size, 4*size);
 	}
-	currentResult = std::sqrt(dtmp/teachData.size());
 }
 
 void TeachingClass::save_current(bool replace) {
@@ -42,13 +129,14 @@ void TeachingClass::save_current(bool replace) {
 	} else if (replace) {
 		*currentPerceptron = *teachingPerceptron_ptr;
 		currentResult = bestResult;
+		get_error();
 	}
-	get_error();
 }
 
 void TeachingClass::teach_back_propagation() {
 	float temp;
 	double dtmp = currentResult;
+	std::vector<float> sampleVec (teachData.inputs());
 	quint32 l2, n2, w2, continues, count = 0;
 	while (1) {
 		for (l2 = 0; l2 < backPropagationWeightsBufferVec.size(); ++l2)
@@ -56,10 +144,11 @@ void TeachingClass::teach_back_propagation() {
 				for (w2 = 0; w2 < backPropagationWeightsBufferVec[l2][n2].size(); ++w2)
 					backPropagationWeightsBufferVec[l2][n2][w2] = .0f;
 		for (quint32 i = 0; i < teachData.size(); ++i) {
-			currentPerceptron->work(teachData[i].first);
+			sampleVec.assign(teachData.input(i), teachData.input(i) + teachData.inputs());
+			currentPerceptron->work(sampleVec);
 			for (l2 = 0; l2 < teachingWeights.size(); ++l2) {
 				neuron_base& a = currentPerceptron->neuronsVec[currentPerceptron->layers() - 1][l2];
-				backPropagationErrorsVec[currentPerceptron->neuronsVec.size()-1][l2] = a.get_func_diff() * (teachData[i].second[l2] - a);
+				backPropagationErrorsVec[currentPerceptron->neuronsVec.size()-1][l2] = a.get_func_diff() * (teachData.target(i)[l2] - a);
 			}
 			for (l2 = currentPerceptron->neuronsVec.size() - 1; l2 != 0; --l2) for (n2 = 0; n2 < teachingPerceptron_ptr->neuronsVec[l2-1].size(); ++n2) {
 				temp = .0f;
@@ -67,7 +156,7 @@ void TeachingClass::teach_back_propagation() {
 				backPropagationErrorsVec[l2-1][n2] = currentPerceptron->neuronsVec[l2-1][n2].get_func_diff() * temp;
 			}
 			for (n2 = 0; n2 < currentPerceptron->neuronsVec[0].size(); ++n2) for (w2 = 0; w2 < currentPerceptron->input.size(); ++w2)
-				backPropagationWeightsBufferVec[0][n2][w2] += currSpeed * backPropagationErrorsVec [0][n2] * teachData[i].first[w2];
+				backPropagationWeightsBufferVec[0][n2][w2] += currSpeed * backPropagationErrorsVec [0][n2] * teachData.input(i)[w2];
 			for (l2 = 1; l2 < currentPerceptron->neuronsVec.size(); ++l2) for (n2 = 0; n2 < currentPerceptron->neuronsVec[l2].size(); ++n2) for (w2 = 0; w2 < currentPerceptron->neuronsVec[l2-1].size(); ++w2)
 				backPropagationWeightsBufferVec[l2][n2][w2] += currSpeed * backPropagationErrorsVec [l2][n2] * currentPerceptron->neuronsVec[l2-1][w2];
 		}
@@ -118,11 +207,12 @@ void TeachingClass::teach_heat_imitation(quint32 l, quint32 n, quint32 w) {
 		dcon = jumpGet(generator) * con * heatImitationConstWeightMult;
 		currentPerceptron->neuronsVec[l][n].drift_weight (dweight, w);
 		currentPerceptron->neuronsVec[l][n].drift_const (dcon);
-		get_error();
+		get_error(l, n, w, dweight, dcon);
 		dTmp = (dTmp - currentResult);
 		if ((dTmp < 0.) && (randEvent(generator) > std::exp(dTmp/temperature/currentResult))) {
 			currentPerceptron->neuronsVec[l][n].drift_weight (-dweight, w);
 			currentPerceptron->neuronsVec[l][n].drift_const (-dcon);
+			restore_cache(l, n);
 			currentResult += dTmp;
 			currInitTemp *= std::pow(heatImitationTemperatureCorrection, 2);
 		} else if (dTmp > 0.) currInitTemp /= heatImitationTemperatureCorrection;
@@ -134,12 +224,46 @@ void TeachingClass::teach_heat_imitation(quint32 l, quint32 n, quint32 w) {
 	}
 }
 
+void TeachingClass::teach_minibatch() {
+	MinibatchTrainer::Optimizer opt = teachingAlgorithm == MinibatchMomentumTeaching ?
+				MinibatchTrainer::MomentumOptimizer : MinibatchTrainer::AdamOptimizer;
+	MinibatchTrainer trainer (*teachingPerceptron_ptr);
+	trainer.set_data(teachData.inputData.data(), teachData.targetData.data(), teachData.size());
+	trainer.set_output_weights(teachingWeights);
+	trainer.set_optimizer(opt);
+	trainer.set_learning_rate(minibatchSpeed > 0. ? minibatchSpeed : MinibatchTrainer::default_learning_rate(opt));
+	trainer.set_batch_size(minibatchSize);
+	bestResult = currentResult = trainer.get_error();
+	progressTotal = totalIterations*minibatchEpochsPerCycle*trainer.batches();
+	generator.seed(time(0));
+	if (trainer.is_zero()) trainer.randomize(generator);
+	for (quint32 e = 0; e < totalIterations*minibatchEpochsPerCycle && isEnabled; ++e) {
+		trainer.shuffle(generator);
+		for (quint32 b = 0; b < trainer.batches() && isEnabled; ++b, ++iProgress) trainer.train_batch(b);
+		currentResult = trainer.get_error();
+		if (currentResult < bestResult) {
+			trainer.store(*teachingPerceptron_ptr);
+			bestResult = currentResult;
+		}
+	}
+}
+
 TeachingClass::TeachingClass() {
 }
 
 double TeachingClass::start(Perceptron *_percep) {
 	teachingPerceptron_ptr = _percep;
+	if (teachingAlgorithm != HeatImitationTeaching) {
+		teachingState = true;
+		isEnabled = true;
+		teach_minibatch();
+		iProgress = 0;
+		teachingState = false;
+		return bestResult;
+	}
+	progressTotal = teachingPerceptron_ptr->total_weights()*totalIterations;
 	currentPerceptron = new Perceptron (*_percep);
+	cache_inputs();
 	get_error();
 	bestResult = currentResult;
 	currSpeed = backPropagationSpeed;
@@ -185,6 +309,11 @@ double TeachingClass::start(Perceptron *_percep) {
 			}
 	}
 	delete currentPerceptron;
+	cachedInputs.clear();
+	cachedInputs.shrink_to_fit();
+	cachedSums.clear();
+	cachedOutputs.clear();
+	cachedBackup.clear();
 	iProgress = 0;
 	teachingState = false;
 	return currentResult;
@@ -196,7 +325,11 @@ double TeachingClass::start(Perceptron *_percep, const std::vector<std::pair<std
 	if (_teachDataInOut[0].first.size() != _percep->input.size()) throw std::invalid_argument ("Error! Input size is wrong.");
 	if (_percep->neuronsVec[_percep->neuronsVec.size() - 1].size() != _teachDataInOut[0].second.size()) throw std::invalid_argument ("Error! Teach data output size is wrong.");
 	if (teachingWeights.size() != _teachDataInOut[0].second.size())  throw std::invalid_argument ("Error! Weights vector size is wrong.");
-	teachData = _teachDataInOut;
+	teachData.resize(_teachDataInOut.size(), _teachDataInOut[0].first.size(), _teachDataInOut[0].second.size());
+	for (quint32 i = 0; i < teachData.size(); ++i) {
+		std::copy(_teachDataInOut[i].first.begin(), _teachDataInOut[i].first.end(), teachData.input(i));
+		std::copy(_teachDataInOut[i].second.begin(), _teachDataInOut[i].second.end(), teachData.target(i));
+	}
 	return start(_percep);
 }
 
@@ -207,8 +340,8 @@ void TeachingClass::set_output_teach_weight(quint32 outp, float weight) {
 }
 
 float TeachingClass::current_progress()  {
-	if (iProgress == teachingPerceptron_ptr->total_weights()*totalIterations) return 1.f;
-	else return static_cast<float> (iProgress)/static_cast<float> (teachingPerceptron_ptr->total_weights()*totalIterations);
+	if (iProgress >= progressTotal) return 1.f;
+	else return static_cast<float> (iProgress)/static_cast<float> (progressTotal);
 }
 
 }
@@ -33,6 +33,38 @@ namespace Neural_Network {
 
 class Perceptron;
 
+// Teaching samples one after another in two contiguous arrays, inputs()
+// floats of every sample in 'inputData' and outputs() floats in 'targetData'
+struct TeachingSet {
+		std::vector<float> inputData;
+		std::vector<float> targetData;
+		quint32 inputsNum = 0;
+		quint32 outputsNum = 0;
+		quint32 samples = 0;
+
+		void resize (quint32 _samples, quint32 _inputs, quint32 _outputs) {
+			samples = _samples;
+			inputsNum = _inputs;
+			outputsNum = _outputs;
+			inputData.resize((size_t)samples*inputsNum);
+			targetData.resize((size_t)samples*outputsNum);
+		}
+		quint32 size () const { return samples; }
+		bool empty () const { return !samples; }
+		quint32 inputs () const { return inputsNum; }
+		quint32 outputs () const { return outputsNum; }
+		float* input (quint32 _index) { return inputData.data() + (size_t)_index*inputsNum; }
+		const float* input (quint32 _index) const { return inputData.data() + (size_t)_index*inputsNum; }
+		float* target (quint32 _index) { return targetData.data() + (size_t)_index*outputsNum; }
+		const float* target (quint32 _index) const { return targetData.data() + (size_t)_index*outputsNum; }
+};
+
+enum TeachingAlgorithms {
+	HeatImitationTeaching = 0,
+	MinibatchAdamTeaching,
+	MinibatchMomentumTeaching
+};
+
 class TeachingClass : public QObject {
 		Q_OBJECT
 		Perceptron* teachingPerceptron_ptr;
@@ -47,27 +79,48 @@ class TeachingClass : public QObject {
 		double heatImitationJumpRadius = 0.2;
 		double heatImitationTemperatureCorrection = 1.1;
 		double heatImitationConstWeightMult = 0.14;
+		quint32 teachingAlgorithm = HeatImitationTeaching;
+		quint32 minibatchSize = 256;
+		quint32 minibatchEpochsPerCycle = 10;
+		// 0 keeps the default rate of the optimizer
+		double minibatchSpeed = 0.;
 		std::vector<float> teachingWeights;
 		std::default_random_engine generator;
 		std::vector<std::vector<float>> backPropagationErrorsVec;
 		std::vector<std::vector<std::vector<float>>> backPropagationWeightsBufferVec;
+		// Layer sums and outputs of currentPerceptron for every teaching sample,
+		// row n of a layer holds neuron n over all samples. get_error() refreshes
+		// them, an annealing jump only updates what lies downstream of its neuron.
+		std::vector<float> cachedInputs;
+		std::vector<std::vector<float>> cachedSums;
+		std::vector<std::vector<float>> cachedOutputs;
+		std::vector<std::vector<float>> cachedBackup;
 
 		double currentResult = 1.;
 		double bestResult = 1.;
 		double currSpeed;
 		double currInitTemp;
 		quint32 iProgress = 0;
+		quint32 progressTotal = 1;
 		bool teachingState = false;
 		bool isEnabled = true;
 
 		void teach_back_propagation ();
 		void teach_heat_imitation (quint32 l, quint32 n, quint32 w);
+		void teach_minibatch ();
 		void get_error ();
+		void get_error (quint32 l, quint32 n, quint32 w, float dweight, float dcon);
+		void restore_cache (quint32 l, quint32 n);
+		void cache_inputs ();
+		const float* cached_input (quint32 l, quint32 w) const;
+		void forward_neuron (quint32 l, quint32 n);
+		void activate_neuron (quint32 l, quint32 n);
+		void cached_error ();
 		void save_current (bool replace = true);
 
 	protected:
 
-		std::vector<std::pair<std::vector<float>, std::vector<float>>> teachData;
+		TeachingSet teachData;
 		double start (Perceptron* _percep);
 
 	public:
@@ -96,6 +149,14 @@ class TeachingClass : public QObject {
 		double heat_imitation_const_wei_mult () { return heatImitationConstWeightMult; }
 		void heat_imitation_jumps (quint32 jumps) { heatImitationNumberOfJumps = jumps; }
 		quint32 heat_imitation_jumps () { return heatImitationNumberOfJumps; }
+		void teaching_algorithm (quint32 _alg) { teachingAlgorithm = _alg; }
+		quint32 teaching_algorithm () { return teachingAlgorithm; }
+		void minibatch_size (quint32 _size) { minibatchSize = _size; }
+		quint32 minibatch_size () { return minibatchSize; }
+		void minibatch_epochs (quint32 _epochs) { minibatchEpochsPerCycle = _epochs; }
+		quint32 minibatch_epochs () { return minibatchEpochsPerCycle; }
+		void minibatch_speed (double _speed) { minibatchSpeed = _speed; }
+		double minibatch_speed () { return minibatchSpeed; }
 		double current_STD () { if (bestResult < currentResult) return bestResult; else return currentResult; }
 		float current_progress ();
 		bool running () { return teachingState; }